@@ -0,0 +1,200 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "AggregationEngine.h"
+#include <homegear-ipc/HelperFunctions.h>
+
+AggregationEngine::AggregationEngine(SummaryCallback summary_callback) : summary_callback_(std::move(summary_callback)) {
+}
+
+AggregationEngine::~AggregationEngine() {
+  {
+    std::lock_guard<std::mutex> aggregators_guard(aggregators_mutex_);
+    stop_timer_ = true;
+  }
+  timer_condition_.notify_all();
+  if (timer_thread_.joinable()) timer_thread_.join();
+}
+
+uint32_t AggregationEngine::Add(uint64_t peer_id, int32_t channel, const std::string &variable_name, int64_t window, int64_t step, bool pass_through) {
+  if (step <= 0 || step > window) step = window;
+
+  auto aggregator = std::make_shared<Aggregator>();
+  aggregator->peer_id = peer_id;
+  aggregator->channel = channel;
+  aggregator->variable_name = variable_name;
+  aggregator->step = step;
+  aggregator->buckets.resize((window + step - 1) / step);
+  aggregator->window = step * aggregator->buckets.size();
+  aggregator->pass_through = pass_through;
+  auto time = Ipc::HelperFunctions::getTime();
+  aggregator->current_bucket_start = time - (time % step);
+
+  {
+    std::lock_guard<std::mutex> aggregators_guard(aggregators_mutex_);
+    aggregator->id = current_id_++;
+    aggregators_.emplace(aggregator->id, aggregator);
+    aggregators_by_variable_[peer_id][channel][variable_name].push_back(aggregator);
+    aggregator_count_++;
+    if (!timer_thread_.joinable()) timer_thread_ = std::thread(&AggregationEngine::TimerThread, this);
+  }
+  //The next window might end earlier than the one the timer is waiting for.
+  timer_condition_.notify_all();
+
+  return aggregator->id;
+}
+
+bool AggregationEngine::Remove(uint32_t aggregator_id) {
+  std::lock_guard<std::mutex> aggregators_guard(aggregators_mutex_);
+  auto aggregator_iterator = aggregators_.find(aggregator_id);
+  if (aggregator_iterator == aggregators_.end()) return false;
+  auto aggregator = aggregator_iterator->second;
+  aggregators_.erase(aggregator_iterator);
+  aggregator_count_--;
+
+  auto peer_iterator = aggregators_by_variable_.find(aggregator->peer_id);
+  if (peer_iterator == aggregators_by_variable_.end()) return true;
+  auto channel_iterator = peer_iterator->second.find(aggregator->channel);
+  if (channel_iterator == peer_iterator->second.end()) return true;
+  auto variable_iterator = channel_iterator->second.find(aggregator->variable_name);
+  if (variable_iterator == channel_iterator->second.end()) return true;
+  auto &variable_aggregators = variable_iterator->second;
+  for (auto element = variable_aggregators.begin(); element != variable_aggregators.end(); ++element) {
+    if ((*element)->id == aggregator_id) {
+      variable_aggregators.erase(element);
+      break;
+    }
+  }
+  if (variable_aggregators.empty()) channel_iterator->second.erase(variable_iterator);
+  if (channel_iterator->second.empty()) peer_iterator->second.erase(channel_iterator);
+  if (peer_iterator->second.empty()) aggregators_by_variable_.erase(peer_iterator);
+  return true;
+}
+
+bool AggregationEngine::Feed(uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value) {
+  if (aggregator_count_ == 0) return false;
+
+  double sample = 0;
+  bool is_numeric = true;
+  if (value->type == Ipc::VariableType::tInteger || value->type == Ipc::VariableType::tInteger64) sample = (double)value->integerValue64;
+  else if (value->type == Ipc::VariableType::tFloat) sample = value->floatValue;
+  else if (value->type == Ipc::VariableType::tBoolean) sample = value->booleanValue ? 1 : 0;
+  else is_numeric = false;
+
+  auto time = Ipc::HelperFunctions::getTime();
+  bool consumed = false;
+  std::vector<Summary> summaries;
+  {
+    std::lock_guard<std::mutex> aggregators_guard(aggregators_mutex_);
+    auto peer_iterator = aggregators_by_variable_.find(peer_id);
+    if (peer_iterator == aggregators_by_variable_.end()) return false;
+    auto channel_iterator = peer_iterator->second.find(channel);
+    if (channel_iterator == peer_iterator->second.end()) return false;
+    auto variable_iterator = channel_iterator->second.find(variable_name);
+    if (variable_iterator == channel_iterator->second.end()) return false;
+
+    for (auto &aggregator : variable_iterator->second) {
+      if (!is_numeric) continue;
+      if (!aggregator->pass_through) consumed = true;
+      Advance(*aggregator, time, summaries);
+      auto &bucket = aggregator->buckets.at(aggregator->current_bucket);
+      if (bucket.count == 0 || sample < bucket.min) bucket.min = sample;
+      if (bucket.count == 0 || sample > bucket.max) bucket.max = sample;
+      bucket.sum += sample;
+      bucket.count++;
+    }
+  }
+
+  for (auto &summary : summaries) {
+    summary_callback_(summary);
+  }
+
+  return consumed;
+}
+
+void AggregationEngine::Advance(Aggregator &aggregator, int64_t time, std::vector<Summary> &summaries) {
+  auto bucket_count = aggregator.buckets.size();
+  size_t steps = 0;
+  while (time >= aggregator.current_bucket_start + aggregator.step) {
+    if (steps++ > bucket_count) {
+      //All buckets were emptied, so the remaining windows have nothing to report.
+      aggregator.current_bucket_start = time - (time % aggregator.step);
+      break;
+    }
+
+    Summary summary;
+    for (auto &bucket : aggregator.buckets) {
+      if (bucket.count == 0) continue;
+      if (summary.count == 0 || bucket.min < summary.min) summary.min = bucket.min;
+      if (summary.count == 0 || bucket.max > summary.max) summary.max = bucket.max;
+      summary.sum += bucket.sum;
+      summary.count += bucket.count;
+    }
+    if (summary.count > 0) {
+      summary.aggregator_id = aggregator.id;
+      summary.peer_id = aggregator.peer_id;
+      summary.channel = aggregator.channel;
+      summary.variable_name = aggregator.variable_name;
+      summary.end = aggregator.current_bucket_start + aggregator.step;
+      summary.start = summary.end - aggregator.window;
+      summaries.emplace_back(std::move(summary));
+    }
+
+    aggregator.current_bucket = (aggregator.current_bucket + 1) % bucket_count;
+    aggregator.buckets.at(aggregator.current_bucket) = Bucket();
+    aggregator.current_bucket_start += aggregator.step;
+  }
+}
+
+void AggregationEngine::TimerThread() {
+  std::unique_lock<std::mutex> aggregators_lock(aggregators_mutex_);
+  while (!stop_timer_) {
+    //Windows are also closed by Feed(), but variables without updates need to be closed here.
+    auto time = Ipc::HelperFunctions::getTime();
+    std::vector<Summary> summaries;
+    int64_t next_time = time + 1000;
+    for (auto &aggregator : aggregators_) {
+      Advance(*aggregator.second, time, summaries);
+      auto bucket_end = aggregator.second->current_bucket_start + aggregator.second->step;
+      if (bucket_end < next_time) next_time = bucket_end;
+    }
+
+    if (!summaries.empty()) {
+      aggregators_lock.unlock();
+      for (auto &summary : summaries) {
+        summary_callback_(summary);
+      }
+      aggregators_lock.lock();
+      continue;
+    }
+
+    timer_condition_.wait_for(aggregators_lock, std::chrono::milliseconds(next_time - time));
+  }
+}
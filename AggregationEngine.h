@@ -0,0 +1,125 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__AGGREGATIONENGINE_H_
+#define HOMEGEAR_NODEJS__AGGREGATIONENGINE_H_
+
+#include <homegear-ipc/Variable.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Computes count, sum, min, max and mean of numeric variables over tumbling or sliding time windows. A window is
+ * split into buckets of one step each, so a sliding window only needs to combine the buckets when it moves. A tumbling
+ * window is a sliding window with only one bucket. Windows are aligned to multiples of the step size.
+ */
+class AggregationEngine {
+ public:
+  struct Summary {
+    uint32_t aggregator_id = 0;
+    uint64_t peer_id = 0;
+    int32_t channel = -1;
+    std::string variable_name;
+    int64_t start = 0;
+    int64_t end = 0;
+    uint64_t count = 0;
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+  };
+  typedef std::function<void(const Summary &summary)> SummaryCallback;
+
+  explicit AggregationEngine(SummaryCallback summary_callback);
+  ~AggregationEngine();
+
+  /**
+   * @param window The window length in milliseconds. Rounded up to a multiple of step.
+   * @param step The time in milliseconds between two summaries. Equal to window for tumbling windows.
+   * @param pass_through When false, events of the variable are consumed by Feed().
+   * @return Returns the ID of the new aggregator.
+   */
+  uint32_t Add(uint64_t peer_id, int32_t channel, const std::string &variable_name, int64_t window, int64_t step, bool pass_through);
+  bool Remove(uint32_t aggregator_id);
+
+  /**
+   * Adds a sample to all aggregators of the variable. Returns true when the event should not be passed on. Non-numeric values are always passed on.
+   */
+  bool Feed(uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value);
+ private:
+  struct Bucket {
+    uint64_t count = 0;
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+  };
+
+  struct Aggregator {
+    uint32_t id = 0;
+    uint64_t peer_id = 0;
+    int32_t channel = -1;
+    std::string variable_name;
+    int64_t window = 0;
+    int64_t step = 0;
+    bool pass_through = false;
+    std::vector<Bucket> buckets;
+    size_t current_bucket = 0;
+    int64_t current_bucket_start = 0;
+  };
+  typedef std::shared_ptr<Aggregator> PAggregator;
+
+  SummaryCallback summary_callback_;
+  std::atomic<size_t> aggregator_count_{0};
+  uint32_t current_id_ = 0;
+
+  std::mutex aggregators_mutex_;
+  std::map<uint32_t, PAggregator> aggregators_;
+  std::unordered_map<uint64_t, std::unordered_map<int32_t, std::unordered_map<std::string, std::vector<PAggregator>>>> aggregators_by_variable_;
+
+  std::condition_variable timer_condition_;
+  std::thread timer_thread_;
+  bool stop_timer_ = false;
+
+  /**
+   * Closes all buckets that ended before time and appends the summaries of the resulting windows.
+   */
+  static void Advance(Aggregator &aggregator, int64_t time, std::vector<Summary> &summaries);
+  void TimerThread();
+};
+
+#endif //HOMEGEAR_NODEJS__AGGREGATIONENGINE_H_
@@ -0,0 +1,108 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Backpressure.h"
+#include <homegear-ipc/HelperFunctions.h>
+
+#include <cassert>
+
+void Backpressure::SetWaterMarks(uint32_t high_water_mark, uint32_t low_water_mark) {
+  high_water_mark_ = high_water_mark;
+  low_water_mark_ = low_water_mark < high_water_mark ? low_water_mark : high_water_mark / 2;
+}
+
+void Backpressure::Enqueued() {
+  auto depth = ++depth_;
+  auto max_depth = max_depth_.load();
+  while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth));
+
+  if (high_water_mark_ == 0 || depth < high_water_mark_ || paused_) return;
+  std::lock_guard<std::mutex> pause_guard(pause_mutex_);
+  if (paused_ || stopped_) return;
+  paused_ = true;
+  pause_count_++;
+  pause_start_time_ = Ipc::HelperFunctions::getTime();
+}
+
+void Backpressure::Dequeued() {
+  auto depth = depth_.load();
+  do {
+    if (depth == 0) {
+      //An item was dequeued that was not counted when it was enqueued. Counted instead of wrapping the depth around, so
+      //the miscount shows up in getStats().
+      assert(false);
+      underflows_++;
+      return;
+    }
+  } while (!depth_.compare_exchange_weak(depth, depth - 1));
+  depth--;
+  if (!paused_ || depth > low_water_mark_) return;
+  {
+    std::lock_guard<std::mutex> pause_guard(pause_mutex_);
+    if (!paused_) return;
+    paused_ = false;
+    resume_count_++;
+    paused_time_ += Ipc::HelperFunctions::getTime() - pause_start_time_;
+  }
+  pause_condition_.notify_all();
+}
+
+void Backpressure::WaitForCapacity() {
+  if (!paused_) return;
+  std::unique_lock<std::mutex> pause_lock(pause_mutex_);
+  while (!pause_condition_.wait_for(pause_lock, std::chrono::milliseconds(1000), [&] {
+    return !paused_ || stopped_;
+  }));
+}
+
+void Backpressure::Stop() {
+  {
+    std::lock_guard<std::mutex> pause_guard(pause_mutex_);
+    stopped_ = true;
+    paused_ = false;
+  }
+  pause_condition_.notify_all();
+}
+
+Ipc::PVariable Backpressure::GetStats() {
+  auto stats = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+  stats->structValue->emplace("depth", std::make_shared<Ipc::Variable>((int64_t)depth_));
+  stats->structValue->emplace("maxDepth", std::make_shared<Ipc::Variable>((int64_t)max_depth_));
+  stats->structValue->emplace("highWaterMark", std::make_shared<Ipc::Variable>((int64_t)high_water_mark_));
+  stats->structValue->emplace("lowWaterMark", std::make_shared<Ipc::Variable>((int64_t)low_water_mark_));
+  stats->structValue->emplace("underflows", std::make_shared<Ipc::Variable>((int64_t)underflows_));
+
+  std::lock_guard<std::mutex> pause_guard(pause_mutex_);
+  stats->structValue->emplace("paused", std::make_shared<Ipc::Variable>((bool)paused_));
+  stats->structValue->emplace("pauses", std::make_shared<Ipc::Variable>((int64_t)pause_count_));
+  stats->structValue->emplace("resumes", std::make_shared<Ipc::Variable>((int64_t)resume_count_));
+  stats->structValue->emplace("pausedTime", std::make_shared<Ipc::Variable>(paused_time_ + (paused_ ? Ipc::HelperFunctions::getTime() - pause_start_time_ : 0)));
+  return stats;
+}
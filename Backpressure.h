@@ -0,0 +1,97 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__BACKPRESSURE_H_
+#define HOMEGEAR_NODEJS__BACKPRESSURE_H_
+
+#include <homegear-ipc/Variable.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Tracks the number of items queued in all thread-safe functions. When the queue depth reaches the high-water mark,
+ * the IPC threads block in WaitForCapacity() until the JavaScript thread has drained the queues to the low-water mark.
+ * Blocked IPC threads don't process further RPCs.
+ *
+ * Limitation: libhomegear-ipc has no way to pause its socket reader, and Homegear's IPC protocol has no flow control.
+ * While the IPC threads are blocked, the reader keeps reading packets into the library's bounded processing queue.
+ * Under sustained overload that queue fills up and the library drops packets. Backpressure only protects the memory of
+ * the thread-safe function queues and smooths bursts. It does not slow Homegear down.
+ */
+class Backpressure {
+ public:
+  /**
+   * A high-water mark of 0 disables blocking. The queue depth is tracked anyway.
+   */
+  void SetWaterMarks(uint32_t high_water_mark, uint32_t low_water_mark);
+
+  /**
+   * Must be called before an item is passed to napi_call_threadsafe_function().
+   */
+  void Enqueued();
+
+  /**
+   * Must be called for every item processed by a thread-safe function callback. Calls without a matching Enqueued()
+   * are counted as underflows.
+   */
+  void Dequeued();
+
+  /**
+   * Blocks while the queues are above the high-water mark and didn't drain to the low-water mark yet.
+   */
+  void WaitForCapacity();
+
+  /**
+   * Releases all waiting threads and disables blocking.
+   */
+  void Stop();
+
+  Ipc::PVariable GetStats();
+ private:
+  uint32_t high_water_mark_ = 0;
+  uint32_t low_water_mark_ = 0;
+  std::atomic_bool stopped_{false};
+  std::atomic<uint32_t> depth_{0};
+  std::atomic<uint32_t> max_depth_{0};
+  std::atomic<uint64_t> underflows_{0};
+  std::atomic_bool paused_{false};
+
+  std::mutex pause_mutex_;
+  std::condition_variable pause_condition_;
+  uint64_t pause_count_ = 0;
+  uint64_t resume_count_ = 0;
+  int64_t pause_start_time_ = 0;
+  int64_t paused_time_ = 0;
+};
+
+#endif //HOMEGEAR_NODEJS__BACKPRESSURE_H_
@@ -0,0 +1,189 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "EventLog.h"
+#include <homegear-ipc/Output.h>
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char kMagic[8] = {'H', 'G', 'E', 'V', 'L', 'O', 'G', '1'};
+const size_t kRecordHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+const size_t kChunkSize = 16 * 1024 * 1024;
+}
+
+EventLogWriter::~EventLogWriter() {
+  Close();
+}
+
+bool EventLogWriter::Open(const std::string &path, std::string &error) {
+  std::lock_guard<std::mutex> log_guard(mutex_);
+  if (fd_ != -1) {
+    error = "Log is already open.";
+    return false;
+  }
+
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ == -1) {
+    error = "Could not open " + path + ": " + std::string(strerror(errno));
+    return false;
+  }
+
+  if (!Grow(sizeof(kMagic))) {
+    error = "Could not map " + path + ": " + std::string(strerror(errno));
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  memcpy(map_, kMagic, sizeof(kMagic));
+  size_ = sizeof(kMagic);
+  packet_count_ = 0;
+  start_time_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+bool EventLogWriter::Grow(size_t required_size) {
+  if (required_size <= capacity_) return true;
+  size_t new_capacity = capacity_ + kChunkSize;
+  while (new_capacity < required_size) new_capacity += kChunkSize;
+
+  if (ftruncate(fd_, (off_t)new_capacity) == -1) return false;
+  void *new_map;
+  if (map_) new_map = mremap(map_, capacity_, new_capacity, MREMAP_MAYMOVE);
+  else new_map = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (new_map == MAP_FAILED) return false;
+
+  map_ = (char *)new_map;
+  capacity_ = new_capacity;
+  return true;
+}
+
+void EventLogWriter::Append(const std::string &method_name, Ipc::PArray &parameters) {
+  auto time = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time_).count();
+
+  //Encode outside of the lock, so the IPC threads only serialize on the copy.
+  thread_local Ipc::RpcEncoder encoder;
+  thread_local std::vector<char> packet;
+  packet.clear();
+  encoder.encodeRequest(method_name, parameters, packet);
+  auto packet_size = (uint32_t)packet.size();
+  if (packet_size == 0) return;
+
+  std::lock_guard<std::mutex> log_guard(mutex_);
+  if (fd_ == -1) return;
+  if (!Grow(size_ + kRecordHeaderSize + packet_size)) {
+    Ipc::Output::printError("Error: Could not grow event log: " + std::string(strerror(errno)));
+    return;
+  }
+
+  memcpy(map_ + size_, &time, sizeof(time));
+  memcpy(map_ + size_ + sizeof(time), &packet_size, sizeof(packet_size));
+  memcpy(map_ + size_ + kRecordHeaderSize, packet.data(), packet_size);
+  size_ += kRecordHeaderSize + packet_size;
+  packet_count_++;
+}
+
+void EventLogWriter::Close() {
+  std::lock_guard<std::mutex> log_guard(mutex_);
+  if (fd_ == -1) return;
+
+  if (map_) munmap(map_, capacity_);
+  map_ = nullptr;
+  capacity_ = 0;
+  //Cut off the unused part of the last chunk.
+  if (ftruncate(fd_, (off_t)size_) == -1) Ipc::Output::printError("Error: Could not truncate event log: " + std::string(strerror(errno)));
+  close(fd_);
+  fd_ = -1;
+}
+
+uint64_t EventLogWriter::PacketCount() {
+  std::lock_guard<std::mutex> log_guard(mutex_);
+  return packet_count_;
+}
+
+EventLogReader::~EventLogReader() {
+  if (map_) munmap(map_, size_);
+  if (fd_ != -1) close(fd_);
+}
+
+bool EventLogReader::Open(const std::string &path, std::string &error) {
+  fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ == -1) {
+    error = "Could not open " + path + ": " + std::string(strerror(errno));
+    return false;
+  }
+
+  struct stat file_info{};
+  if (fstat(fd_, &file_info) == -1 || (size_t)file_info.st_size < sizeof(kMagic)) {
+    error = path + " is not an event log.";
+    return false;
+  }
+  size_ = (size_t)file_info.st_size;
+
+  auto *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (map == MAP_FAILED) {
+    error = "Could not map " + path + ": " + std::string(strerror(errno));
+    size_ = 0;
+    return false;
+  }
+  map_ = (char *)map;
+  madvise(map_, size_, MADV_SEQUENTIAL);
+
+  if (memcmp(map_, kMagic, sizeof(kMagic)) != 0) {
+    error = path + " is not an event log.";
+    return false;
+  }
+  position_ = sizeof(kMagic);
+  return true;
+}
+
+bool EventLogReader::Next(int64_t &time, std::string &method_name, Ipc::PArray &parameters) {
+  if (!map_ || size_ - position_ < kRecordHeaderSize) return false;
+
+  uint64_t packet_time = 0;
+  uint32_t packet_size = 0;
+  memcpy(&packet_time, map_ + position_, sizeof(packet_time));
+  memcpy(&packet_size, map_ + position_ + sizeof(packet_time), sizeof(packet_size));
+  if (packet_size == 0 || packet_size > size_ - position_ - kRecordHeaderSize) return false;
+
+  packet_.assign(map_ + position_ + kRecordHeaderSize, map_ + position_ + kRecordHeaderSize + packet_size);
+  position_ += kRecordHeaderSize + packet_size;
+
+  time = (int64_t)packet_time;
+  method_name.clear();
+  parameters = decoder_.decodeRequest(packet_, method_name);
+  return (bool)parameters;
+}
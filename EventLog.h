@@ -0,0 +1,92 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__EVENTLOG_H_
+#define HOMEGEAR_NODEJS__EVENTLOG_H_
+
+#include <homegear-ipc/Variable.h>
+#include <homegear-ipc/RpcEncoder.h>
+#include <homegear-ipc/RpcDecoder.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+/**
+ * Append-only log of RPC packets received from Homegear. The file starts with an 8 byte magic followed by records of
+ * a 64 bit timestamp (microseconds since the start of the recording), a 32 bit packet size and the packet as encoded
+ * by Ipc::RpcEncoder. Integers are stored in native byte order. The file is written through a memory mapping that
+ * grows in chunks, so appending a packet is a memcpy. A log that was not closed properly ends in zeros, which the
+ * reader treats as the end of the log.
+ */
+class EventLogWriter {
+ public:
+  EventLogWriter() = default;
+  ~EventLogWriter();
+
+  bool Open(const std::string &path, std::string &error);
+  void Append(const std::string &method_name, Ipc::PArray &parameters);
+  void Close();
+  uint64_t PacketCount();
+ private:
+  bool Grow(size_t required_size);
+
+  std::mutex mutex_;
+  int fd_ = -1;
+  char *map_ = nullptr;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+  uint64_t packet_count_ = 0;
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+class EventLogReader {
+ public:
+  EventLogReader() = default;
+  ~EventLogReader();
+
+  bool Open(const std::string &path, std::string &error);
+
+  /**
+   * Decodes the next packet. Returns false at the end of the log.
+   *
+   * @param time Set to the time of the packet in microseconds since the start of the recording.
+   */
+  bool Next(int64_t &time, std::string &method_name, Ipc::PArray &parameters);
+ private:
+  int fd_ = -1;
+  char *map_ = nullptr;
+  size_t size_ = 0;
+  size_t position_ = 0;
+  Ipc::RpcDecoder decoder_;
+  std::vector<char> packet_;
+};
+
+#endif //HOMEGEAR_NODEJS__EVENTLOG_H_
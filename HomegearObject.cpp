@@ -4,20 +4,104 @@
 
 #include "HomegearObject.h"
 #include "NapiVariableConverter.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <vector>
+
+Homegear::Homegear(const std::string &socket_path, const Ipc::PVariable &options) : env_(nullptr), wrapper_(nullptr) {
+  auto high_water_mark = GetOption(options, "queueHighWaterMark")->integerValue64;
+  auto low_water_mark = GetOption(options, "queueLowWaterMark")->integerValue64;
+  if (high_water_mark > 0) backpressure_.SetWaterMarks((uint32_t)high_water_mark, low_water_mark > 0 ? (uint32_t)low_water_mark : 0);
+
+  aggregation_engine_ = std::make_unique<AggregationEngine>(std::bind(&Homegear::OnAggregate, this, std::placeholders::_1));
 
-Homegear::Homegear(const std::string &socket_path) : env_(nullptr), wrapper_(nullptr) {
   ipc_client_ = std::make_unique<IpcClient>(socket_path);
+
+  auto ipc_threads = GetOption(options, "ipcThreads")->integerValue64;
+  if (ipc_threads > 0) ipc_thread_count_ = (uint32_t)ipc_threads;
+  auto cpu_affinity = GetOption(options, "ipcCpuAffinity");
+  if (!cpu_affinity->arrayValue->empty()) {
+    std::vector<int32_t> cpus;
+    cpus.reserve(cpu_affinity->arrayValue->size());
+    for (auto &cpu : *cpu_affinity->arrayValue) {
+      cpus.push_back((int32_t)cpu->integerValue64);
+    }
+    ipc_client_->SetCpuAffinity(cpus);
+  }
+  ipc_client_->SetReaderPriority((int32_t)GetOption(options, "ipcReaderPriority")->integerValue64);
+
+  auto cache_methods = GetOption(options, "cacheMethods");
+  if (!cache_methods->arrayValue->empty()) {
+    std::unordered_set<std::string> methods;
+    for (auto &method : *cache_methods->arrayValue) {
+      methods.emplace(method->stringValue);
+    }
+    result_cache_.SetMethods(methods);
+  }
+  auto cache_max_entries = GetOption(options, "cacheMaxEntries")->integerValue64;
+  if (cache_max_entries > 0) result_cache_.SetMaxEntries((size_t)cache_max_entries);
+
+  resync_ = GetOption(options, "resync")->booleanValue;
+
+  auto conversion_max_depth = GetOption(options, "conversionMaxDepth")->integerValue64;
+  if (conversion_max_depth > 0) conversion_limits_.max_depth = (uint32_t)conversion_max_depth;
+  auto conversion_max_size = GetOption(options, "conversionMaxSize")->integerValue64;
+  if (conversion_max_size > 0) conversion_limits_.max_size = (size_t)conversion_max_size;
+  auto conversion_time_slice = GetOption(options, "conversionTimeSlice")->integerValue64;
+  if (conversion_time_slice > 0) conversion_time_slice_ = std::chrono::milliseconds(conversion_time_slice);
+
+  auto offline_queue_size = GetOption(options, "offlineQueueSize")->integerValue64;
+  if (offline_queue_size > 0) offline_queue_size_ = (size_t)offline_queue_size;
+  auto offline_timeout = GetOption(options, "offlineTimeout")->integerValue64;
+  if (offline_timeout > 0) offline_timeout_ = offline_timeout;
+
+  auto watchdog_threshold = GetOption(options, "watchdogThreshold")->integerValue64;
+  if (watchdog_threshold > 0) watchdog_threshold_ = watchdog_threshold;
+  auto node_method_timeout = GetOption(options, "nodeMethodTimeout")->integerValue64;
+  if (node_method_timeout > 0) node_method_timeout_ = node_method_timeout;
+
   ipc_client_->SetOnConnect(std::bind(&Homegear::OnConnect, this));
   ipc_client_->SetOnDisconnect(std::bind(&Homegear::OnDisconnect, this));
+  ipc_client_->SetDevicesChanged(std::bind(&Homegear::OnDevicesChanged, this));
   ipc_client_->SetBroadcastEvent(std::bind(&Homegear::OnEvent, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
-  ipc_client_->SetNodeInput(std::bind(&Homegear::OnNodeInput, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
-  ipc_client_->SetInvokeNodeMethod(std::bind(&Homegear::OnInvokeNodeMethod, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
-  ipc_client_->start();
+  ipc_client_->SetNodeInput(std::bind(&Homegear::OnNodeInput, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6, std::placeholders::_7));
+  ipc_client_->SetInvokeNodeMethod(std::bind(&Homegear::OnInvokeNodeMethod, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+  ipc_client_->SetInvokeNodeMethodFinished(std::bind(&Homegear::OnInvokeNodeMethodFinished, this, std::placeholders::_1));
 }
 
 Homegear::~Homegear() {
+  disposing_ = true;
+  backpressure_.Stop();
+  watchdog_.Stop();
+  {
+    std::lock_guard<std::mutex> replay_guard(replay_mutex_);
+    stop_replay_ = true;
+  }
+  replay_condition_.notify_all();
+  if (replay_thread_.joinable()) replay_thread_.join();
+  {
+    std::lock_guard<std::mutex> nodes_guard(nodes_mutex_);
+    for (auto &node : nodes_) {
+      node.second->in_flight_condition.notify_all();
+    }
+  }
+  //Stop the client first. This unblocks a resync waiting in invoke(), so joining the thread can't hang.
+  if (ipc_client_) ipc_client_->stop();
+  {
+    std::lock_guard<std::mutex> resync_thread_guard(resync_thread_mutex_);
+    if (resync_thread_.joinable()) resync_thread_.join();
+  }
   ipc_client_.reset();
+  aggregation_engine_.reset();
+  for (auto &aggregator_callback : aggregator_callbacks_) {
+    napi_delete_reference(env_, aggregator_callback.second);
+  }
+  if (watchdog_callback_) napi_delete_reference(env_, watchdog_callback_);
+  result_cache_.Clear();
+  for (auto &node : nodes_) {
+    DeleteNode(node.second);
+  }
   //Don't call napi_release_threadsafe_function() here. This would doubly release them (found out with valgrind)
   napi_delete_reference(env_, wrapper_);
 }
@@ -34,11 +118,28 @@ napi_value Homegear::Init(napi_env env, napi_value exports) {
   napi_status status;
   napi_property_descriptor properties[] = {
       DECLARE_NAPI_METHOD("connected", Connected),
-      DECLARE_NAPI_METHOD("invoke", Invoke)
+      DECLARE_NAPI_METHOD("invoke", Invoke),
+      DECLARE_NAPI_METHOD("invokeAsync", InvokeAsync),
+      DECLARE_NAPI_METHOD("getStats", GetStats),
+      DECLARE_NAPI_METHOD("registerVariable", RegisterVariable),
+      DECLARE_NAPI_METHOD("unregisterVariable", UnregisterVariable),
+      DECLARE_NAPI_METHOD("setVariableEventCallback", SetVariableEventCallback),
+      DECLARE_NAPI_METHOD("snapshot", TakeSnapshot),
+      DECLARE_NAPI_METHOD("startTracing", StartTracing),
+      DECLARE_NAPI_METHOD("stopTracing", StopTracing),
+      DECLARE_NAPI_METHOD("startRecording", StartRecording),
+      DECLARE_NAPI_METHOD("stopRecording", StopRecording),
+      DECLARE_NAPI_METHOD("replay", Replay),
+      DECLARE_NAPI_METHOD("stopReplay", StopReplay),
+      DECLARE_NAPI_METHOD("registerAggregator", RegisterAggregator),
+      DECLARE_NAPI_METHOD("unregisterAggregator", UnregisterAggregator),
+      DECLARE_NAPI_METHOD("registerNode", RegisterNode),
+      DECLARE_NAPI_METHOD("setWatchdogCallback", SetWatchdogCallback),
+      DECLARE_NAPI_METHOD("unregisterNode", UnregisterNode)
   };
 
   napi_value cons;
-  status = napi_define_class(env, "Homegear", NAPI_AUTO_LENGTH, New, nullptr, 2, properties, &cons);
+  status = napi_define_class(env, "Homegear", NAPI_AUTO_LENGTH, New, nullptr, sizeof(properties) / sizeof(properties[0]), properties, &cons);
   assert(status == napi_ok);
 
   // We will need the constructor `cons` later during the life cycle of the
@@ -84,6 +185,12 @@ napi_value Homegear::Constructor(napi_env env) {
   return cons;
 }
 
+Ipc::PVariable Homegear::GetOption(const Ipc::PVariable &options, const std::string &name) {
+  auto option_iterator = options->structValue->find(name);
+  if (option_iterator == options->structValue->end() || !option_iterator->second) return std::make_shared<Ipc::Variable>();
+  return option_iterator->second;
+}
+
 napi_value Homegear::New(napi_env env, napi_callback_info info) {
   napi_status status;
 
@@ -94,8 +201,8 @@ napi_value Homegear::New(napi_env env, napi_callback_info info) {
 
   if (is_constructor) {
     // Invoked as constructor: `new Homegear(...)`
-    size_t argc = 6;
-    napi_value args[6];
+    size_t argc = 7;
+    napi_value args[7];
     napi_value jsthis;
     status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
     assert(status == napi_ok);
@@ -115,27 +222,28 @@ napi_value Homegear::New(napi_env env, napi_callback_info info) {
     }
     if (socket_path.empty()) socket_path = "/var/run/homegear/homegearIPC.sock";
 
+    auto options = NapiVariableConverter::getVariable(env, args[6]);
+
     Homegear *obj = nullptr;
     { //Create new object
-      obj = new Homegear(socket_path);
+      obj = new Homegear(socket_path, options);
       obj->env_ = env;
       status = napi_wrap(env, jsthis, reinterpret_cast<void *>(obj), Homegear::Destructor, nullptr /* finalize_hint */, &obj->wrapper_);
       assert(status == napi_ok);
     }
 
-    { //OnConnect
+    { //OnConnect. Created without a JavaScript callback, too, as the offline queue is flushed from it.
       napi_value on_connect_callback_js = args[1];
       status = napi_typeof(env, on_connect_callback_js, &valuetype);
       assert(status == napi_ok);
-      if (valuetype == napi_function) {
-        napi_value resource_name;
-        status = napi_create_string_utf8(env, "Thread-safe call from OnConnect()", NAPI_AUTO_LENGTH, &resource_name);
-        assert(status == napi_ok);
-        status = napi_create_threadsafe_function(env, on_connect_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, nullptr, OnConnectJs, &obj->on_connect_threadsafe_function_);
-        assert(status == napi_ok);
-        status = napi_unref_threadsafe_function(env, obj->on_connect_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
-        assert(status == napi_ok);
-      }
+      if (valuetype != napi_function) on_connect_callback_js = nullptr;
+      napi_value resource_name;
+      status = napi_create_string_utf8(env, "Thread-safe call from OnConnect()", NAPI_AUTO_LENGTH, &resource_name);
+      assert(status == napi_ok);
+      status = napi_create_threadsafe_function(env, on_connect_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnConnectJs, &obj->on_connect_threadsafe_function_);
+      assert(status == napi_ok);
+      status = napi_unref_threadsafe_function(env, obj->on_connect_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
+      assert(status == napi_ok);
     }
 
     { //OnDisconnect
@@ -146,7 +254,7 @@ napi_value Homegear::New(napi_env env, napi_callback_info info) {
         napi_value resource_name;
         status = napi_create_string_utf8(env, "Thread-safe call from OnDisconnect()", NAPI_AUTO_LENGTH, &resource_name);
         assert(status == napi_ok);
-        status = napi_create_threadsafe_function(env, on_disconnect_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, nullptr, OnDisconnectJs, &obj->on_disconnect_threadsafe_function_);
+        status = napi_create_threadsafe_function(env, on_disconnect_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnDisconnectJs, &obj->on_disconnect_threadsafe_function_);
         assert(status == napi_ok);
         status = napi_unref_threadsafe_function(env, obj->on_disconnect_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
         assert(status == napi_ok);
@@ -161,7 +269,7 @@ napi_value Homegear::New(napi_env env, napi_callback_info info) {
         napi_value resource_name;
         status = napi_create_string_utf8(env, "Thread-safe call from OnEvent()", NAPI_AUTO_LENGTH, &resource_name);
         assert(status == napi_ok);
-        status = napi_create_threadsafe_function(env, on_event_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, nullptr, OnEventJs, &obj->on_event_threadsafe_function_);
+        status = napi_create_threadsafe_function(env, on_event_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnEventJs, &obj->on_event_threadsafe_function_);
         assert(status == napi_ok);
         status = napi_unref_threadsafe_function(env, obj->on_event_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
         assert(status == napi_ok);
@@ -176,7 +284,7 @@ napi_value Homegear::New(napi_env env, napi_callback_info info) {
         napi_value resource_name;
         status = napi_create_string_utf8(env, "Thread-safe call from OnNodeInput()", NAPI_AUTO_LENGTH, &resource_name);
         assert(status == napi_ok);
-        status = napi_create_threadsafe_function(env, on_node_input_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, nullptr, OnNodeInputJs, &obj->on_node_input_threadsafe_function_);
+        status = napi_create_threadsafe_function(env, on_node_input_callback_js, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnNodeInputJs, &obj->on_node_input_threadsafe_function_);
         assert(status == napi_ok);
         status = napi_unref_threadsafe_function(env, obj->on_node_input_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
         assert(status == napi_ok);
@@ -198,16 +306,64 @@ napi_value Homegear::New(napi_env env, napi_callback_info info) {
       }
     }
 
+    { //Nodes registered with registerNode(). The JavaScript functions are looked up per node, so no function is passed here.
+      napi_value resource_name;
+      status = napi_create_string_utf8(env, "Thread-safe call from OnNodeInput() for registered nodes", NAPI_AUTO_LENGTH, &resource_name);
+      assert(status == napi_ok);
+      status = napi_create_threadsafe_function(env, nullptr, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnRegisteredNodeInputJs, &obj->on_registered_node_input_threadsafe_function_);
+      assert(status == napi_ok);
+      status = napi_unref_threadsafe_function(env, obj->on_registered_node_input_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
+      assert(status == napi_ok);
+
+      status = napi_create_string_utf8(env, "Thread-safe call from OnInvokeNodeMethod() for registered nodes", NAPI_AUTO_LENGTH, &resource_name);
+      assert(status == napi_ok);
+      status = napi_create_threadsafe_function(env, nullptr, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnRegisteredNodeMethodJs, &obj->on_registered_node_method_threadsafe_function_);
+      assert(status == napi_ok);
+      status = napi_unref_threadsafe_function(env, obj->on_registered_node_method_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
+      assert(status == napi_ok);
+    }
+
+    { //Aggregators registered with registerAggregator(). The JavaScript functions are looked up per aggregator.
+      napi_value resource_name;
+      status = napi_create_string_utf8(env, "Thread-safe call from OnAggregate()", NAPI_AUTO_LENGTH, &resource_name);
+      assert(status == napi_ok);
+      status = napi_create_threadsafe_function(env, nullptr, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnAggregateJs, &obj->on_aggregate_threadsafe_function_);
+      assert(status == napi_ok);
+      status = napi_unref_threadsafe_function(env, obj->on_aggregate_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
+      assert(status == napi_ok);
+    }
+
+    { //Watchdog heartbeats
+      napi_value resource_name;
+      status = napi_create_string_utf8(env, "Thread-safe call from SendWatchdogHeartbeat()", NAPI_AUTO_LENGTH, &resource_name);
+      assert(status == napi_ok);
+      status = napi_create_threadsafe_function(env, nullptr, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnWatchdogJs, &obj->on_watchdog_threadsafe_function_);
+      assert(status == napi_ok);
+      status = napi_unref_threadsafe_function(env, obj->on_watchdog_threadsafe_function_); //Allow destruction of process even though the reference counter is not 0
+      assert(status == napi_ok);
+    }
+
+    if (obj->watchdog_threshold_ > 0 || obj->node_method_timeout_ > 0) {
+      //Check a few times per threshold, so stalls and timeouts are detected with little delay.
+      int64_t interval = 1000;
+      if (obj->watchdog_threshold_ > 0) interval = std::min(interval, obj->watchdog_threshold_ / 4);
+      if (obj->node_method_timeout_ > 0) interval = std::min(interval, obj->node_method_timeout_ / 4);
+      obj->watchdog_.Start(obj->watchdog_threshold_, std::max((int64_t)10, interval), std::bind(&Homegear::SendWatchdogHeartbeat, obj), std::bind(&Homegear::ExpireNodeMethods, obj));
+    }
+
+    //Start after all thread-safe functions are created, so no callback is missed.
+    obj->ipc_client_->start(obj->ipc_thread_count_);
+
     return jsthis;
   } else {
     // Invoked as plain function `Homegear(...)`, turn into construct call.
-    size_t argc_ = 6;
+    size_t argc_ = 7;
     napi_value args[argc_];
     status = napi_get_cb_info(env, info, &argc_, args, nullptr, nullptr);
     assert(status == napi_ok);
 
-    const size_t argc = 6;
-    napi_value argv[argc] = {args[0], args[1], args[2], args[3], args[4], args[5]};
+    const size_t argc = 7;
+    napi_value argv[argc] = {args[0], args[1], args[2], args[3], args[4], args[5], args[6]};
 
     napi_value instance;
     status = napi_new_instance(env, Constructor(env), argc, argv, &instance);
@@ -218,10 +374,16 @@ napi_value Homegear::New(napi_env env, napi_callback_info info) {
 }
 
 void Homegear::OnConnectJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) {
+    auto obj = static_cast<Homegear *>(context);
+    obj->backpressure_.Dequeued();
+    obj->FlushOfflineQueue(env);
+  }
+
   // env and callback may both be NULL if Node.js is in its cleanup phase, and
   // items are left over from earlier thread-safe calls from the worker thread.
   // When env is NULL, we simply skip over the call into Javascript and free the
-  // items.
+  // items. callback is also NULL when no connected callback was passed.
   if (env && callback) {
     // Retrieve the JavaScript `undefined` value so we can use it as the `this`
     // value of the JavaScript function call.
@@ -235,9 +397,22 @@ void Homegear::OnConnectJs(napi_env env, napi_value callback, void *context, voi
 }
 
 void Homegear::OnConnect() {
+  //Changes while disconnected were missed.
+  result_cache_.Invalidate();
+
+  if (resync_) {
+    //Homegear can't be called from the thread reporting the connection, so a separate thread is used.
+    std::lock_guard<std::mutex> resync_thread_guard(resync_thread_mutex_);
+    if (!disposing_) {
+      if (resync_thread_.joinable()) resync_thread_.join();
+      resync_thread_ = std::thread(&Homegear::Resync, this);
+    }
+  }
+
   if (!on_connect_threadsafe_function_) return;
   auto status = napi_acquire_threadsafe_function(on_connect_threadsafe_function_);
   assert(status == napi_ok);
+  backpressure_.Enqueued();
   status = napi_call_threadsafe_function(on_connect_threadsafe_function_, nullptr, napi_tsfn_nonblocking);
   assert(status == napi_ok);
   status = napi_release_threadsafe_function(on_connect_threadsafe_function_, napi_tsfn_release);
@@ -245,6 +420,8 @@ void Homegear::OnConnect() {
 }
 
 void Homegear::OnDisconnectJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) static_cast<Homegear *>(context)->backpressure_.Dequeued();
+
   // env and callback may both be NULL if Node.js is in its cleanup phase, and
   // items are left over from earlier thread-safe calls from the worker thread.
   // When env is NULL, we simply skip over the call into Javascript and free the
@@ -262,16 +439,25 @@ void Homegear::OnDisconnectJs(napi_env env, napi_value callback, void *context,
 }
 
 void Homegear::OnDisconnect() {
+  result_cache_.Invalidate();
+
   if (!on_disconnect_threadsafe_function_) return;
   auto status = napi_acquire_threadsafe_function(on_disconnect_threadsafe_function_);
   assert(status == napi_ok);
+  backpressure_.Enqueued();
   status = napi_call_threadsafe_function(on_disconnect_threadsafe_function_, nullptr, napi_tsfn_nonblocking);
   assert(status == napi_ok);
   status = napi_release_threadsafe_function(on_disconnect_threadsafe_function_, napi_tsfn_release);
   assert(status == napi_ok);
 }
 
+void Homegear::OnDevicesChanged() {
+  result_cache_.Invalidate();
+}
+
 void Homegear::OnEventJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) static_cast<Homegear *>(context)->backpressure_.Dequeued();
+
   // env and callback may both be NULL if Node.js is in its cleanup phase, and
   // items are left over from earlier thread-safe calls from the worker thread.
   // When env is NULL, we simply skip over the call into Javascript and free the
@@ -283,10 +469,14 @@ void Homegear::OnEventJs(napi_env env, napi_value callback, void *context, void
     auto status = napi_get_undefined(env, &undefined);
     assert(status == napi_ok);
 
-    size_t argc = 5;
+    size_t argc = 6;
     napi_value args[argc];
 
+    auto obj = static_cast<Homegear *>(context);
     auto *event_struct = (OnEventStruct *)data;
+    obj->TraceQueueTime("event", event_struct->enqueue_time);
+
+    TraceSpan convert_span(obj->tracer_, "event", "convert");
     status = napi_create_string_utf8(env, event_struct->event_source.c_str(), NAPI_AUTO_LENGTH, &args[0]);
     assert(status == napi_ok);
     status = napi_create_int64(env, event_struct->peer_id, &args[1]);
@@ -296,8 +486,11 @@ void Homegear::OnEventJs(napi_env env, napi_value callback, void *context, void
     status = napi_create_string_utf8(env, event_struct->variable_name.c_str(), NAPI_AUTO_LENGTH, &args[3]);
     assert(status == napi_ok);
     args[4] = NapiVariableConverter::getNapiVariable(env, event_struct->value);
+    status = napi_get_boolean(env, event_struct->resync, &args[5]);
     assert(status == napi_ok);
+    convert_span.End();
 
+    TraceSpan js_span(obj->tracer_, "event", "js");
     status = napi_call_function(env, undefined, callback, argc, args, nullptr);
     assert(status == napi_ok);
   }
@@ -305,7 +498,77 @@ void Homegear::OnEventJs(napi_env env, napi_value callback, void *context, void
   delete (OnEventStruct *)data;
 }
 
+void Homegear::OnVariableEventJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) static_cast<Homegear *>(context)->backpressure_.Dequeued();
+
+  // env and callback may both be NULL if Node.js is in its cleanup phase, and
+  // items are left over from earlier thread-safe calls from the worker thread.
+  // When env is NULL, we simply skip over the call into Javascript and free the
+  // items.
+  auto *variable_event_struct = (OnVariableEventStruct *)data;
+  //The variable might have been unregistered while the event was queued and its handle reused since.
+  if (env && callback && context && static_cast<Homegear *>(context)->variable_handles_.IsCurrent(variable_event_struct->handle, variable_event_struct->generation)) {
+    // Retrieve the JavaScript `undefined` value so we can use it as the `this`
+    // value of the JavaScript function call.
+    napi_value undefined;
+    auto status = napi_get_undefined(env, &undefined);
+    assert(status == napi_ok);
+
+    size_t argc = 3;
+    napi_value args[argc];
+
+    auto obj = static_cast<Homegear *>(context);
+    obj->TraceQueueTime("event", variable_event_struct->enqueue_time);
+
+    TraceSpan convert_span(obj->tracer_, "event", "convert");
+    status = napi_create_uint32(env, variable_event_struct->handle, &args[0]);
+    assert(status == napi_ok);
+    args[1] = NapiVariableConverter::getNapiVariable(env, variable_event_struct->value);
+    status = napi_get_boolean(env, variable_event_struct->resync, &args[2]);
+    assert(status == napi_ok);
+    convert_span.End();
+
+    TraceSpan js_span(obj->tracer_, "event", "js");
+    status = napi_call_function(env, undefined, callback, argc, args, nullptr);
+    assert(status == napi_ok);
+  }
+
+  delete variable_event_struct;
+}
+
 void Homegear::OnEvent(std::string &event_source, uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value) {
+  TraceSpan dispatch_span(tracer_, "event", "dispatch");
+  if (resync_) value_store_.Set(peer_id, channel, variable_name, value);
+  if (aggregation_engine_->Feed(peer_id, channel, variable_name, value)) return;
+  DispatchEvent(event_source, peer_id, channel, variable_name, value, false);
+}
+
+void Homegear::DispatchEvent(const std::string &event_source, uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value, bool resync) {
+  backpressure_.WaitForCapacity();
+
+  napi_threadsafe_function on_variable_event_threadsafe_function = on_variable_event_threadsafe_function_;
+  if (on_variable_event_threadsafe_function) {
+    //Events of registered variables are passed to JavaScript by handle only, so no strings need to be copied or created.
+    uint32_t generation = 0;
+    auto handle = variable_handles_.Find(peer_id, channel, variable_name, generation);
+    if (handle != -1) {
+      auto status = napi_acquire_threadsafe_function(on_variable_event_threadsafe_function);
+      assert(status == napi_ok);
+      auto *data = new OnVariableEventStruct;
+      data->handle = (uint32_t)handle;
+      data->generation = generation;
+      data->value = value;
+      data->resync = resync;
+      if (tracer_.Enabled()) data->enqueue_time = Tracer::Now();
+      backpressure_.Enqueued();
+      status = napi_call_threadsafe_function(on_variable_event_threadsafe_function, data, napi_tsfn_nonblocking);
+      assert(status == napi_ok);
+      status = napi_release_threadsafe_function(on_variable_event_threadsafe_function, napi_tsfn_release);
+      assert(status == napi_ok);
+      return;
+    }
+  }
+
   if (!on_event_threadsafe_function_) return;
   auto status = napi_acquire_threadsafe_function(on_event_threadsafe_function_);
   assert(status == napi_ok);
@@ -315,18 +578,103 @@ void Homegear::OnEvent(std::string &event_source, uint64_t peer_id, int32_t chan
   data->channel = channel;
   data->variable_name = variable_name;
   data->value = value;
+  data->resync = resync;
+  if (tracer_.Enabled()) data->enqueue_time = Tracer::Now();
+  backpressure_.Enqueued();
   status = napi_call_threadsafe_function(on_event_threadsafe_function_, data, napi_tsfn_nonblocking);
   assert(status == napi_ok);
   status = napi_release_threadsafe_function(on_event_threadsafe_function_, napi_tsfn_release);
   assert(status == napi_ok);
 }
 
+void Homegear::OnAggregateJs(napi_env env, napi_value callback, void *context, void *data) {
+  auto *summary = (AggregationEngine::Summary *)data;
+  if (env && context) {
+    auto obj = static_cast<Homegear *>(context);
+    obj->backpressure_.Dequeued();
+
+    //The aggregator might have been unregistered while the summary was queued.
+    auto callback_iterator = obj->aggregator_callbacks_.find(summary->aggregator_id);
+    if (callback_iterator != obj->aggregator_callbacks_.end()) {
+      napi_value undefined;
+      auto status = napi_get_undefined(env, &undefined);
+      assert(status == napi_ok);
+
+      auto summary_struct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+      summary_struct->structValue->emplace("peerId", std::make_shared<Ipc::Variable>((int64_t)summary->peer_id));
+      summary_struct->structValue->emplace("channel", std::make_shared<Ipc::Variable>((int64_t)summary->channel));
+      summary_struct->structValue->emplace("variableName", std::make_shared<Ipc::Variable>(summary->variable_name));
+      summary_struct->structValue->emplace("start", std::make_shared<Ipc::Variable>(summary->start));
+      summary_struct->structValue->emplace("end", std::make_shared<Ipc::Variable>(summary->end));
+      summary_struct->structValue->emplace("count", std::make_shared<Ipc::Variable>((int64_t)summary->count));
+      summary_struct->structValue->emplace("sum", std::make_shared<Ipc::Variable>(summary->sum));
+      summary_struct->structValue->emplace("min", std::make_shared<Ipc::Variable>(summary->min));
+      summary_struct->structValue->emplace("max", std::make_shared<Ipc::Variable>(summary->max));
+      summary_struct->structValue->emplace("mean", std::make_shared<Ipc::Variable>(summary->sum / (double)summary->count));
+      summary_struct->structValue->emplace("rate", std::make_shared<Ipc::Variable>((double)summary->count * 1000.0 / (double)(summary->end - summary->start)));
+      napi_value args[1];
+      args[0] = NapiVariableConverter::getNapiVariable(env, summary_struct);
+
+      napi_value aggregator_callback;
+      status = napi_get_reference_value(env, callback_iterator->second, &aggregator_callback);
+      assert(status == napi_ok);
+      status = napi_call_function(env, undefined, aggregator_callback, 1, args, nullptr);
+      assert(status == napi_ok);
+    }
+  }
+
+  delete summary;
+}
+
+void Homegear::OnAggregate(const AggregationEngine::Summary &summary) {
+  backpressure_.WaitForCapacity();
+
+  auto status = napi_acquire_threadsafe_function(on_aggregate_threadsafe_function_);
+  assert(status == napi_ok);
+  auto *data = new AggregationEngine::Summary(summary);
+  backpressure_.Enqueued();
+  status = napi_call_threadsafe_function(on_aggregate_threadsafe_function_, data, napi_tsfn_nonblocking);
+  assert(status == napi_ok);
+  status = napi_release_threadsafe_function(on_aggregate_threadsafe_function_, napi_tsfn_release);
+  assert(status == napi_ok);
+}
+
+void Homegear::Resync() {
+  auto start_time = Ipc::HelperFunctions::getTime();
+  bool reconnect = resync_attempted_.exchange(true);
+  auto parameters = std::make_shared<Ipc::Array>();
+  auto all_values = ipc_client_->invoke("getAllValues", parameters);
+  if (all_values->errorStruct || disposing_) return;
+
+  //Values missing in the store are only reported once a getAllValues result filled it. Before, there is nothing to
+  //compare them with. Values the store got from events are always compared, so a failed first resync doesn't hide
+  //the changes made while disconnected.
+  bool report_new_values = initial_sync_done_;
+  uint64_t changed_values = 0;
+  bool success = value_store_.Update(all_values, start_time, report_new_values, [&](uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value) {
+    if (disposing_) return;
+    DispatchEvent("resync", peer_id, channel, variable_name, value, true);
+    changed_values++;
+  });
+  if (!success) return;
+
+  initial_sync_done_ = true;
+  if (reconnect) {
+    resync_count_++;
+    resync_changed_values_ += changed_values;
+    resync_duration_ = Ipc::HelperFunctions::getTime() - start_time;
+  }
+}
+
 void Homegear::OnNodeInputJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) static_cast<Homegear *>(context)->backpressure_.Dequeued();
+
   // env and callback may both be NULL if Node.js is in its cleanup phase, and
   // items are left over from earlier thread-safe calls from the worker thread.
   // When env is NULL, we simply skip over the call into Javascript and free the
   // items.
-  if (env && callback) {
+  auto *node_input_struct = (OnNodeInputStruct *)data;
+  if (env && callback && context) {
     // Retrieve the JavaScript `undefined` value so we can use it as the `this`
     // value of the JavaScript function call.
     napi_value undefined;
@@ -336,47 +684,169 @@ void Homegear::OnNodeInputJs(napi_env env, napi_value callback, void *context, v
     size_t argc = 5;
     napi_value args[argc];
 
-    auto *node_input_struct = (OnNodeInputStruct *)data;
+    auto obj = static_cast<Homegear *>(context);
+    obj->TraceQueueTime("nodeInput", node_input_struct->enqueue_time);
+    auto start_time = Tracer::Now();
+
+    TraceSpan convert_span(obj->tracer_, "nodeInput", "convert");
     status = napi_create_string_utf8(env, node_input_struct->node_id.c_str(), NAPI_AUTO_LENGTH, &args[0]);
     assert(status == napi_ok);
     args[1] = NapiVariableConverter::getNapiVariable(env, node_input_struct->node_info);
-    assert(status == napi_ok);
     status = napi_create_uint32(env, node_input_struct->input_index, &args[2]);
     assert(status == napi_ok);
     args[3] = NapiVariableConverter::getNapiVariable(env, node_input_struct->message);
-    assert(status == napi_ok);
     status = napi_get_boolean(env, node_input_struct->synchronous, &args[4]);
     assert(status == napi_ok);
+    convert_span.End();
 
-    status = napi_call_function(env, undefined, callback, argc, args, nullptr);
-    assert(status == napi_ok);
+    TraceSpan js_span(obj->tracer_, "nodeInput", "js");
+    napi_value return_val;
+    status = napi_call_function(env, undefined, callback, argc, args, &return_val);
+    js_span.End();
+
+    auto thread_id = node_input_struct->thread_id;
+    auto request_id = node_input_struct->request_id;
+    auto synchronous = node_input_struct->synchronous;
+    auto enqueue_time = node_input_struct->enqueue_time;
+    auto node_id = node_input_struct->node_id;
+    obj->SettleResult(env, status, return_val, false, [obj, thread_id, request_id, synchronous, enqueue_time, start_time, node_id](const Ipc::PVariable &result) {
+      if (enqueue_time != 0 && obj->watchdog_.Enabled()) obj->watchdog_.Record(node_id, "input", start_time - enqueue_time, Tracer::Now() - start_time);
+      obj->FinishNodeInput(PNodeRegistration(), thread_id, request_id, synchronous, result);
+    });
+  }
+
+  delete node_input_struct;
+}
+
+void Homegear::OnRegisteredNodeInputJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) static_cast<Homegear *>(context)->backpressure_.Dequeued();
+
+  auto *node_input_struct = (OnNodeInputStruct *)data;
+  if (env && context) {
+    auto obj = static_cast<Homegear *>(context);
+    auto &node = node_input_struct->node;
+    obj->TraceQueueTime("nodeInput", node_input_struct->enqueue_time);
+    auto start_time = Tracer::Now();
+    if (node->input) {
+      TraceSpan convert_span(obj->tracer_, "nodeInput", "convert");
+      napi_value undefined;
+      auto status = napi_get_undefined(env, &undefined);
+      assert(status == napi_ok);
+
+      size_t argc = 4;
+      napi_value args[argc];
+
+      // The node info rarely changes, so the converted object is kept and only rebuilt when it differs from the last one.
+      if (node->node_info && node->node_info_source && *node->node_info_source == *node_input_struct->node_info) {
+        status = napi_get_reference_value(env, node->node_info, &args[0]);
+        assert(status == napi_ok);
+      } else {
+        args[0] = NapiVariableConverter::getNapiVariable(env, node_input_struct->node_info);
+        if (node->node_info) {
+          status = napi_delete_reference(env, node->node_info);
+          assert(status == napi_ok);
+          node->node_info = nullptr;
+          node->node_info_source.reset();
+        }
+        if (node_input_struct->node_info->type == Ipc::VariableType::tStruct || node_input_struct->node_info->type == Ipc::VariableType::tArray) {
+          status = napi_create_reference(env, args[0], 1, &node->node_info);
+          assert(status == napi_ok);
+          node->node_info_source = node_input_struct->node_info;
+        }
+      }
+      status = napi_create_uint32(env, node_input_struct->input_index, &args[1]);
+      assert(status == napi_ok);
+      args[2] = NapiVariableConverter::getNapiVariable(env, node_input_struct->message);
+      status = napi_get_boolean(env, node_input_struct->synchronous, &args[3]);
+      assert(status == napi_ok);
+      convert_span.End();
+
+      napi_value input;
+      status = napi_get_reference_value(env, node->input, &input);
+      assert(status == napi_ok);
+      TraceSpan js_span(obj->tracer_, "nodeInput", "js");
+      napi_value return_val;
+      status = napi_call_function(env, undefined, input, argc, args, &return_val);
+      js_span.End();
+
+      auto thread_id = node_input_struct->thread_id;
+      auto request_id = node_input_struct->request_id;
+      auto synchronous = node_input_struct->synchronous;
+      auto enqueue_time = node_input_struct->enqueue_time;
+      obj->SettleResult(env, status, return_val, false, [obj, node, thread_id, request_id, synchronous, enqueue_time, start_time](const Ipc::PVariable &result) {
+        if (enqueue_time != 0 && obj->watchdog_.Enabled()) obj->watchdog_.Record(node->node_id, "input", start_time - enqueue_time, Tracer::Now() - start_time);
+        obj->FinishNodeInput(node, thread_id, request_id, synchronous, result);
+      });
+    } else {
+      // The node was unregistered while the input was queued. The input is dropped.
+      obj->FinishNodeInput(node, node_input_struct->thread_id, node_input_struct->request_id, node_input_struct->synchronous, std::make_shared<Ipc::Variable>());
+    }
   }
 
-  delete (OnNodeInputStruct *)data;
+  delete node_input_struct;
 }
 
-void Homegear::OnNodeInput(const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous) {
-  if (!on_node_input_threadsafe_function_) return;
-  auto status = napi_acquire_threadsafe_function(on_node_input_threadsafe_function_);
+bool Homegear::OnNodeInput(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous) {
+  TraceSpan dispatch_span(tracer_, "nodeInput", "dispatch");
+  auto node = GetNode(node_id);
+  if (node && !node->has_input) node.reset();
+  auto threadsafe_function = node ? on_registered_node_input_threadsafe_function_ : on_node_input_threadsafe_function_;
+  if (!threadsafe_function) return false;
+
+  backpressure_.WaitForCapacity();
+
+  if (node && node->max_in_flight > 0) {
+    //Blocking here delays the reply to Homegear, so Homegear doesn't send more inputs than the node can process.
+    std::unique_lock<std::mutex> in_flight_lock(node->in_flight_mutex);
+    while (!node->in_flight_condition.wait_for(in_flight_lock, std::chrono::milliseconds(1000), [&] {
+      return node->in_flight < node->max_in_flight || !node->registered || disposing_;
+    }));
+    node->in_flight++;
+  }
+
+  auto status = napi_acquire_threadsafe_function(threadsafe_function);
   assert(status == napi_ok);
   auto *data = new OnNodeInputStruct;
+  data->node = node;
+  data->thread_id = thread_id;
+  data->request_id = request_id;
   data->node_id = node_id;
   data->node_info = node_info;
   data->input_index = input_index;
   data->message = message;
   data->synchronous = synchronous;
-  status = napi_call_threadsafe_function(on_node_input_threadsafe_function_, data, napi_tsfn_nonblocking);
+  if (tracer_.Enabled() || watchdog_.Enabled()) data->enqueue_time = Tracer::Now();
+  backpressure_.Enqueued();
+  status = napi_call_threadsafe_function(threadsafe_function, data, napi_tsfn_nonblocking);
   assert(status == napi_ok);
-  status = napi_release_threadsafe_function(on_node_input_threadsafe_function_, napi_tsfn_release);
+  status = napi_release_threadsafe_function(threadsafe_function, napi_tsfn_release);
   assert(status == napi_ok);
+
+  return true;
+}
+
+void Homegear::FinishNodeInput(const PNodeRegistration &node, pthread_t thread_id, uint64_t request_id, bool synchronous, const Ipc::PVariable &result) {
+  if (node && node->max_in_flight > 0) {
+    {
+      std::lock_guard<std::mutex> in_flight_guard(node->in_flight_mutex);
+      if (node->in_flight > 0) node->in_flight--;
+    }
+    node->in_flight_condition.notify_one();
+  }
+
+  if (synchronous) ipc_client_->InvokeResult(thread_id, request_id, result->errorStruct ? result : std::make_shared<Ipc::Variable>());
 }
 
 void Homegear::OnInvokeNodeMethodJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) static_cast<Homegear *>(context)->backpressure_.Dequeued();
+
   // env and callback may both be NULL if Node.js is in its cleanup phase, and
   // items are left over from earlier thread-safe calls from the worker thread.
   // When env is NULL, we simply skip over the call into Javascript and free the
   // items.
-  if (env && callback && context) {
+  auto *invoke_node_method_struct = (OnInvokeNodeMethodStruct *)data;
+  //The call might have timed out while it was queued.
+  if (env && callback && context && static_cast<Homegear *>(context)->IsNodeMethodPending(invoke_node_method_struct->thread_id, invoke_node_method_struct->request_id)) {
     // Retrieve the JavaScript `undefined` value so we can use it as the `this`
     // value of the JavaScript function call.
     napi_value undefined;
@@ -386,44 +856,325 @@ void Homegear::OnInvokeNodeMethodJs(napi_env env, napi_value callback, void *con
     size_t argc = 3;
     napi_value args[3];
 
-    auto *invoke_node_method_struct = (OnInvokeNodeMethodStruct *)data;
+    auto obj = static_cast<Homegear *>(context);
+    obj->TraceQueueTime("nodeMethod", invoke_node_method_struct->enqueue_time);
+    auto start_time = Tracer::Now();
+
+    TraceSpan convert_span(obj->tracer_, "nodeMethod", "convert");
     status = napi_create_string_utf8(env, invoke_node_method_struct->node_id.c_str(), NAPI_AUTO_LENGTH, &args[0]);
     assert(status == napi_ok);
     status = napi_create_string_utf8(env, invoke_node_method_struct->method_name.c_str(), NAPI_AUTO_LENGTH, &args[1]);
     assert(status == napi_ok);
     args[2] = NapiVariableConverter::getNapiVariable(env, invoke_node_method_struct->parameters);
-    assert(status == napi_ok);
+    convert_span.End();
 
+    TraceSpan js_span(obj->tracer_, "nodeMethod", "js");
     napi_value return_val;
     status = napi_call_function(env, undefined, callback, argc, args, &return_val);
-    assert(status == napi_ok);
+    js_span.End();
+
+    auto thread_id = invoke_node_method_struct->thread_id;
+    auto request_id = invoke_node_method_struct->request_id;
+    auto enqueue_time = invoke_node_method_struct->enqueue_time;
+    auto node_id = invoke_node_method_struct->node_id;
+    auto method_name = invoke_node_method_struct->method_name;
+    obj->SettleResult(env, status, return_val, true, [obj, thread_id, request_id, enqueue_time, start_time, node_id, method_name](const Ipc::PVariable &result) {
+      if (enqueue_time != 0 && obj->watchdog_.Enabled()) obj->watchdog_.Record(node_id, method_name, start_time - enqueue_time, Tracer::Now() - start_time);
+      obj->FinishNodeMethod(thread_id, request_id, result);
+    });
+  }
 
-    auto result = NapiVariableConverter::getVariable(env, return_val);
+  delete invoke_node_method_struct;
+}
+
+void Homegear::OnRegisteredNodeMethodJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) static_cast<Homegear *>(context)->backpressure_.Dequeued();
 
+  auto *invoke_node_method_struct = (OnInvokeNodeMethodStruct *)data;
+  //The call might have timed out while it was queued.
+  if (env && context && static_cast<Homegear *>(context)->IsNodeMethodPending(invoke_node_method_struct->thread_id, invoke_node_method_struct->request_id)) {
     auto obj = static_cast<Homegear *>(context);
-    obj->ipc_client_->InvokeResult(invoke_node_method_struct->thread_id, result);
+    auto &node = invoke_node_method_struct->node;
+    obj->TraceQueueTime("nodeMethod", invoke_node_method_struct->enqueue_time);
+    auto start_time = Tracer::Now();
+    napi_value methods = nullptr;
+    napi_value method = nullptr;
+    if (node->methods) {
+      auto status = napi_get_reference_value(env, node->methods, &methods);
+      assert(status == napi_ok);
+      bool has_method = false;
+      status = napi_has_named_property(env, methods, invoke_node_method_struct->method_name.c_str(), &has_method);
+      assert(status == napi_ok);
+      if (has_method) {
+        status = napi_get_named_property(env, methods, invoke_node_method_struct->method_name.c_str(), &method);
+        assert(status == napi_ok);
+        napi_valuetype valuetype;
+        status = napi_typeof(env, method, &valuetype);
+        assert(status == napi_ok);
+        if (valuetype != napi_function) method = nullptr;
+      }
+    }
+
+    if (method) {
+      // The parameters are passed as individual arguments to the method.
+      TraceSpan convert_span(obj->tracer_, "nodeMethod", "convert");
+      auto &parameters = invoke_node_method_struct->parameters;
+      std::vector<napi_value> args;
+      if (parameters->type == Ipc::VariableType::tArray) {
+        args.reserve(parameters->arrayValue->size());
+        for (auto &parameter : *parameters->arrayValue) {
+          args.emplace_back(NapiVariableConverter::getNapiVariable(env, parameter));
+        }
+      } else {
+        args.emplace_back(NapiVariableConverter::getNapiVariable(env, parameters));
+      }
+      convert_span.End();
+
+      TraceSpan js_span(obj->tracer_, "nodeMethod", "js");
+      napi_value return_val;
+      auto status = napi_call_function(env, methods, method, args.size(), args.data(), &return_val);
+      js_span.End();
+
+      auto thread_id = invoke_node_method_struct->thread_id;
+      auto request_id = invoke_node_method_struct->request_id;
+      auto enqueue_time = invoke_node_method_struct->enqueue_time;
+      auto method_name = invoke_node_method_struct->method_name;
+      obj->SettleResult(env, status, return_val, true, [obj, node, thread_id, request_id, enqueue_time, start_time, method_name](const Ipc::PVariable &result) {
+        if (enqueue_time != 0 && obj->watchdog_.Enabled()) obj->watchdog_.Record(node->node_id, method_name, start_time - enqueue_time, Tracer::Now() - start_time);
+        obj->FinishNodeMethod(thread_id, request_id, result);
+      });
+    } else {
+      obj->FinishNodeMethod(invoke_node_method_struct->thread_id, invoke_node_method_struct->request_id, Ipc::Variable::createError(-1, "Unknown method."));
+    }
   }
 
-  delete (OnInvokeNodeMethodStruct *)data;
+  delete invoke_node_method_struct;
 }
 
-bool Homegear::OnInvokeNodeMethod(pthread_t thread_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters) {
-  if (!on_invoke_node_method_threadsafe_function_) return false;
-  auto status = napi_acquire_threadsafe_function(on_invoke_node_method_threadsafe_function_);
+bool Homegear::OnInvokeNodeMethod(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters) {
+  TraceSpan dispatch_span(tracer_, "nodeMethod", "dispatch");
+  auto node = GetNode(node_id);
+  auto threadsafe_function = node ? on_registered_node_method_threadsafe_function_ : on_invoke_node_method_threadsafe_function_;
+  if (!threadsafe_function) return false;
+  backpressure_.WaitForCapacity();
+  auto status = napi_acquire_threadsafe_function(threadsafe_function);
   assert(status == napi_ok);
   auto *data = new OnInvokeNodeMethodStruct;
+  data->node = node;
   data->thread_id = thread_id;
+  data->request_id = request_id;
   data->node_id = node_id;
   data->method_name = method_name;
   data->parameters = parameters;
-  status = napi_call_threadsafe_function(on_invoke_node_method_threadsafe_function_, data, napi_tsfn_nonblocking);
+  if (tracer_.Enabled() || watchdog_.Enabled()) data->enqueue_time = Tracer::Now();
+  if (node_method_timeout_ > 0) {
+    std::lock_guard<std::mutex> pending_node_methods_guard(pending_node_methods_mutex_);
+    auto &pending_node_method = pending_node_methods_[thread_id];
+    pending_node_method.request_id = request_id;
+    pending_node_method.start_time = Ipc::HelperFunctions::getTime();
+  }
+  backpressure_.Enqueued();
+  status = napi_call_threadsafe_function(threadsafe_function, data, napi_tsfn_nonblocking);
   assert(status == napi_ok);
-  status = napi_release_threadsafe_function(on_invoke_node_method_threadsafe_function_, napi_tsfn_release);
+  status = napi_release_threadsafe_function(threadsafe_function, napi_tsfn_release);
   assert(status == napi_ok);
 
   return true;
 }
 
+bool Homegear::IsNodeMethodPending(pthread_t thread_id, uint64_t request_id) {
+  if (node_method_timeout_ == 0) return true;
+  std::lock_guard<std::mutex> pending_node_methods_guard(pending_node_methods_mutex_);
+  auto pending_node_method_iterator = pending_node_methods_.find(thread_id);
+  return pending_node_method_iterator != pending_node_methods_.end() && pending_node_method_iterator->second.request_id == request_id;
+}
+
+void Homegear::FinishNodeMethod(pthread_t thread_id, uint64_t request_id, const Ipc::PVariable &result) {
+  if (node_method_timeout_ > 0) {
+    //When the call timed out, it was already answered by ExpireNodeMethods().
+    std::lock_guard<std::mutex> pending_node_methods_guard(pending_node_methods_mutex_);
+    auto pending_node_method_iterator = pending_node_methods_.find(thread_id);
+    if (pending_node_method_iterator == pending_node_methods_.end() || pending_node_method_iterator->second.request_id != request_id) return;
+    pending_node_methods_.erase(pending_node_method_iterator);
+  }
+  //The IPC thread might have stopped waiting and wait for a different request now. InvokeResult() drops the result then.
+  ipc_client_->InvokeResult(thread_id, request_id, result);
+}
+
+void Homegear::OnInvokeNodeMethodFinished(pthread_t thread_id) {
+  if (node_method_timeout_ == 0) return;
+  //The IPC thread stopped waiting, possibly because of the IPC timeout. Remove the entry, so it isn't counted as timed
+  //out later.
+  std::lock_guard<std::mutex> pending_node_methods_guard(pending_node_methods_mutex_);
+  pending_node_methods_.erase(thread_id);
+}
+
+void Homegear::ExpireNodeMethods() {
+  if (node_method_timeout_ == 0) return;
+  auto time = Ipc::HelperFunctions::getTime();
+  //Free the IPC threads. Results of the handlers arriving later are dropped by FinishNodeMethod().
+  std::lock_guard<std::mutex> pending_node_methods_guard(pending_node_methods_mutex_);
+  for (auto pending_node_method_iterator = pending_node_methods_.begin(); pending_node_method_iterator != pending_node_methods_.end();) {
+    if (time - pending_node_method_iterator->second.start_time >= node_method_timeout_) {
+      timed_out_node_methods_++;
+      ipc_client_->InvokeResult(pending_node_method_iterator->first, pending_node_method_iterator->second.request_id, Ipc::Variable::createError(-32503, "Node method call timed out."));
+      pending_node_method_iterator = pending_node_methods_.erase(pending_node_method_iterator);
+    } else {
+      pending_node_method_iterator++;
+    }
+  }
+}
+
+void Homegear::OnWatchdogJs(napi_env env, napi_value callback, void *context, void *data) {
+  if (env && context) {
+    auto obj = static_cast<Homegear *>(context);
+    obj->backpressure_.Dequeued();
+
+    Watchdog::StallReport report;
+    if (obj->watchdog_.HeartbeatReceived(report) && obj->watchdog_callback_) {
+      napi_value undefined;
+      auto status = napi_get_undefined(env, &undefined);
+      assert(status == napi_ok);
+
+      auto report_struct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+      report_struct->structValue->emplace("duration", std::make_shared<Ipc::Variable>(report.duration));
+      report_struct->structValue->emplace("slowestHandlers", report.slowest_handlers);
+      napi_value args[1];
+      args[0] = NapiVariableConverter::getNapiVariable(env, report_struct);
+
+      napi_value watchdog_callback;
+      status = napi_get_reference_value(env, obj->watchdog_callback_, &watchdog_callback);
+      assert(status == napi_ok);
+      status = napi_call_function(env, undefined, watchdog_callback, 1, args, nullptr);
+      assert(status == napi_ok);
+    }
+  }
+}
+
+void Homegear::SendWatchdogHeartbeat() {
+  //Never blocks, so the watchdog keeps running when the queue is full.
+  auto status = napi_acquire_threadsafe_function(on_watchdog_threadsafe_function_);
+  assert(status == napi_ok);
+  backpressure_.Enqueued();
+  status = napi_call_threadsafe_function(on_watchdog_threadsafe_function_, nullptr, napi_tsfn_nonblocking);
+  assert(status == napi_ok);
+  status = napi_release_threadsafe_function(on_watchdog_threadsafe_function_, napi_tsfn_release);
+  assert(status == napi_ok);
+}
+
+void Homegear::TraceQueueTime(const char *category, int64_t enqueue_time) {
+  //enqueue_time is only set when tracing was enabled when the item was queued.
+  if (enqueue_time != 0 && tracer_.Enabled()) tracer_.Add(category, "queue", enqueue_time, Tracer::Now());
+}
+
+void Homegear::SettleResult(napi_env env, napi_status call_status, napi_value value, bool convert_result, std::function<void(const Ipc::PVariable &result)> finish) {
+  if (call_status != napi_ok) {
+    //The handler threw. The exception stays pending, so Node.js reports it as usual.
+    finish(Ipc::Variable::createError(-1, "Handler threw an exception."));
+    return;
+  }
+
+  bool is_promise = false;
+  auto status = napi_is_promise(env, value, &is_promise);
+  assert(status == napi_ok);
+  if (!is_promise) {
+    finish(convert_result ? NapiVariableConverter::getVariable(env, value) : std::make_shared<Ipc::Variable>());
+    return;
+  }
+
+  auto *pending_result = new PendingResult;
+  pending_result->finish = std::move(finish);
+  pending_result->convert_result = convert_result;
+  //Keep this object alive until the Promise is settled.
+  napi_value jsthis;
+  status = napi_get_reference_value(env, wrapper_, &jsthis);
+  assert(status == napi_ok);
+  status = napi_create_reference(env, jsthis, 1, &pending_result->keep_alive);
+  assert(status == napi_ok);
+
+  napi_value then_function;
+  status = napi_get_named_property(env, value, "then", &then_function);
+  assert(status == napi_ok);
+  napi_value args[2];
+  //Only one of both functions is called. It frees pending_result.
+  status = napi_create_function(env, "onFulfilled", NAPI_AUTO_LENGTH, OnPromiseFulfilled, pending_result, &args[0]);
+  assert(status == napi_ok);
+  status = napi_create_function(env, "onRejected", NAPI_AUTO_LENGTH, OnPromiseRejected, pending_result, &args[1]);
+  assert(status == napi_ok);
+  status = napi_call_function(env, value, then_function, 2, args, nullptr);
+  assert(status == napi_ok);
+}
+
+napi_value Homegear::OnPromiseFulfilled(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  void *data = nullptr;
+  auto status = napi_get_cb_info(env, info, &argc, args, nullptr, &data);
+  assert(status == napi_ok);
+
+  auto *pending_result = (PendingResult *)data;
+  pending_result->finish(pending_result->convert_result && argc > 0 ? NapiVariableConverter::getVariable(env, args[0]) : std::make_shared<Ipc::Variable>());
+  status = napi_delete_reference(env, pending_result->keep_alive);
+  assert(status == napi_ok);
+  delete pending_result;
+
+  return nullptr;
+}
+
+napi_value Homegear::OnPromiseRejected(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  void *data = nullptr;
+  auto status = napi_get_cb_info(env, info, &argc, args, nullptr, &data);
+  assert(status == napi_ok);
+
+  std::string message = "Promise was rejected.";
+  if (argc > 0) {
+    napi_valuetype valuetype;
+    status = napi_typeof(env, args[0], &valuetype);
+    assert(status == napi_ok);
+    if (valuetype == napi_object) {
+      napi_value message_value;
+      status = napi_get_named_property(env, args[0], "message", &message_value);
+      assert(status == napi_ok);
+      auto message_variable = NapiVariableConverter::getVariable(env, message_value);
+      if (!message_variable->stringValue.empty()) message = message_variable->stringValue;
+    } else if (valuetype == napi_string) {
+      message = NapiVariableConverter::getVariable(env, args[0])->stringValue;
+    }
+  }
+
+  auto *pending_result = (PendingResult *)data;
+  pending_result->finish(Ipc::Variable::createError(-1, message));
+  status = napi_delete_reference(env, pending_result->keep_alive);
+  assert(status == napi_ok);
+  delete pending_result;
+
+  return nullptr;
+}
+
+Homegear::PNodeRegistration Homegear::GetNode(const std::string &node_id) {
+  std::lock_guard<std::mutex> nodes_guard(nodes_mutex_);
+  if (nodes_.empty()) return PNodeRegistration();
+  auto node_iterator = nodes_.find(node_id);
+  if (node_iterator == nodes_.end()) return PNodeRegistration();
+  return node_iterator->second;
+}
+
+void Homegear::DeleteNode(const PNodeRegistration &node) {
+  node->registered = false;
+  node->in_flight_condition.notify_all();
+
+  //Inputs and method calls still queued for this node check for nullptr and are dropped.
+  if (node->input) napi_delete_reference(env_, node->input);
+  node->input = nullptr;
+  if (node->methods) napi_delete_reference(env_, node->methods);
+  node->methods = nullptr;
+  if (node->node_info) napi_delete_reference(env_, node->node_info);
+  node->node_info = nullptr;
+  node->node_info_source.reset();
+}
+
 napi_value Homegear::Invoke(napi_env env, napi_callback_info info) {
   size_t argc = 2;
   napi_value args[argc];
@@ -444,21 +1195,332 @@ napi_value Homegear::Invoke(napi_env env, napi_callback_info info) {
   status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
   assert(status == napi_ok);
 
-  auto rpc_result = obj->ipc_client_->invoke(method->stringValue, parameters->arrayValue);
+  auto rpc_result = obj->InvokeCached(method->stringValue, parameters->arrayValue);
   if (rpc_result->errorStruct) {
     status = napi_throw_error(env, std::to_string(rpc_result->structValue->at("faultCode")->integerValue).c_str(), rpc_result->structValue->at("faultString")->stringValue.c_str());
     assert(status == napi_ok);
     return nullptr;
   }
 
-  return NapiVariableConverter::getNapiVariable(env, rpc_result);
+  TraceSpan convert_span(obj->tracer_, "invoke", "convert");
+  NapiVariableConverter::Conversion conversion(rpc_result, obj->conversion_limits_);
+  conversion.Continue(env, std::chrono::microseconds(0));
+  convert_span.End();
+  if (!conversion.Error().empty()) {
+    status = napi_throw_range_error(env, "-1", conversion.Error().c_str());
+    assert(status == napi_ok);
+    return nullptr;
+  }
+  return conversion.Result();
 }
 
-napi_value Homegear::Connected(napi_env env, napi_callback_info info) {
-  size_t argc = 0;
-  napi_value jsthis;
-  auto status = napi_get_cb_info(env, info, &argc, nullptr, &jsthis, nullptr);
-  assert(status == napi_ok);
+Ipc::PVariable Homegear::InvokeCached(const std::string &method, const Ipc::PArray &parameters) {
+  bool cacheable = result_cache_.IsCacheable(method);
+  uint64_t cache_generation = 0;
+  if (cacheable) {
+    auto cached_result = result_cache_.Get(method, parameters);
+    if (cached_result) return cached_result;
+    cache_generation = result_cache_.Generation();
+  }
+
+  TraceSpan ipc_span(tracer_, "invoke", "ipc");
+  auto result = ipc_client_->invoke(method, parameters);
+  ipc_span.End();
+  if (cacheable) result_cache_.Set(method, parameters, result, cache_generation);
+  return result;
+}
+
+napi_value Homegear::InvokeAsync(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  auto method = NapiVariableConverter::getVariable(env, args[0]);
+  auto parameters = NapiVariableConverter::getVariable(env, args[1]);
+
+  if (method->stringValue.empty()) {
+    status = napi_throw_type_error(env, "-1", "method is not a String or empty.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  auto *async_invoke = new AsyncInvoke;
+  async_invoke->obj = obj;
+  async_invoke->method = method->stringValue;
+  async_invoke->parameters = parameters->arrayValue;
+  //Keep this object alive until the Promise is settled.
+  status = napi_create_reference(env, jsthis, 1, &async_invoke->keep_alive);
+  assert(status == napi_ok);
+
+  napi_value promise;
+  status = napi_create_promise(env, &async_invoke->deferred, &promise);
+  assert(status == napi_ok);
+
+  if (obj->offline_queue_size_ > 0 && !obj->ipc_client_->connected()) {
+    auto timeout = obj->offline_timeout_;
+    if (argc == 3) {
+      auto offline_timeout = GetOption(NapiVariableConverter::getVariable(env, args[2]), "offlineTimeout")->integerValue64;
+      if (offline_timeout > 0) timeout = offline_timeout;
+    }
+    obj->QueueOfflineInvoke(env, async_invoke, timeout);
+    return promise;
+  }
+
+  StartAsyncInvoke(env, async_invoke);
+
+  return promise;
+}
+
+void Homegear::StartAsyncInvoke(napi_env env, AsyncInvoke *async_invoke) {
+  napi_value resource_name;
+  auto status = napi_create_string_utf8(env, "Homegear.invokeAsync()", NAPI_AUTO_LENGTH, &resource_name);
+  assert(status == napi_ok);
+  status = napi_create_async_work(env, nullptr, resource_name, ExecuteAsyncInvoke, CompleteAsyncInvoke, async_invoke, &async_invoke->work);
+  assert(status == napi_ok);
+  status = napi_queue_async_work(env, async_invoke->work);
+  assert(status == napi_ok);
+}
+
+void Homegear::ExecuteAsyncInvoke(napi_env env, void *data) {
+  auto *async_invoke = (AsyncInvoke *)data;
+  async_invoke->result = async_invoke->obj->InvokeCached(async_invoke->method, async_invoke->parameters);
+}
+
+void Homegear::CompleteAsyncInvoke(napi_env env, napi_status status, void *data) {
+  auto *async_invoke = (AsyncInvoke *)data;
+  napi_delete_async_work(env, async_invoke->work);
+  async_invoke->work = nullptr;
+
+  if (status != napi_ok || !async_invoke->result) {
+    FinishAsyncInvoke(env, async_invoke, nullptr, CreateError(env, Ipc::Variable::createError(-32500, "Unknown application error.")));
+    return;
+  }
+  if (async_invoke->result->errorStruct) {
+    FinishAsyncInvoke(env, async_invoke, nullptr, CreateError(env, async_invoke->result));
+    return;
+  }
+
+  async_invoke->conversion = std::make_unique<NapiVariableConverter::Conversion>(async_invoke->result, async_invoke->obj->conversion_limits_);
+  ContinueAsyncInvokeConversion(env, async_invoke);
+}
+
+void Homegear::ContinueAsyncInvokeConversion(napi_env env, AsyncInvoke *async_invoke) {
+  auto &conversion = async_invoke->conversion;
+  TraceSpan convert_span(async_invoke->obj->tracer_, "invoke", "convert");
+  bool finished = conversion->Continue(env, async_invoke->obj->conversion_time_slice_);
+  convert_span.End();
+  if (!finished) {
+    //Time slice used up. Give the event loop a chance to run and continue in the next iteration.
+    conversion->Suspend(env);
+
+    napi_value global;
+    auto status = napi_get_global(env, &global);
+    assert(status == napi_ok);
+    napi_value set_immediate;
+    status = napi_get_named_property(env, global, "setImmediate", &set_immediate);
+    assert(status == napi_ok);
+    napi_value continue_function;
+    status = napi_create_function(env, "continueConversion", NAPI_AUTO_LENGTH, OnContinueAsyncInvokeConversion, async_invoke, &continue_function);
+    assert(status == napi_ok);
+    status = napi_call_function(env, global, set_immediate, 1, &continue_function, nullptr);
+    assert(status == napi_ok);
+    return;
+  }
+
+  if (!conversion->Error().empty()) {
+    napi_value code;
+    auto status = napi_create_string_utf8(env, "-1", NAPI_AUTO_LENGTH, &code);
+    assert(status == napi_ok);
+    napi_value message;
+    status = napi_create_string_utf8(env, conversion->Error().c_str(), NAPI_AUTO_LENGTH, &message);
+    assert(status == napi_ok);
+    napi_value error;
+    status = napi_create_range_error(env, code, message, &error);
+    assert(status == napi_ok);
+    FinishAsyncInvoke(env, async_invoke, nullptr, error);
+    return;
+  }
+
+  FinishAsyncInvoke(env, async_invoke, conversion->Result(), nullptr);
+}
+
+napi_value Homegear::OnContinueAsyncInvokeConversion(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  void *data = nullptr;
+  auto status = napi_get_cb_info(env, info, &argc, nullptr, nullptr, &data);
+  assert(status == napi_ok);
+
+  ContinueAsyncInvokeConversion(env, (AsyncInvoke *)data);
+
+  return nullptr;
+}
+
+void Homegear::FinishAsyncInvoke(napi_env env, AsyncInvoke *async_invoke, napi_value result, napi_value error) {
+  napi_status status;
+  if (error) {
+    status = napi_reject_deferred(env, async_invoke->deferred, error);
+  } else {
+    status = napi_resolve_deferred(env, async_invoke->deferred, result);
+  }
+  assert(status == napi_ok);
+
+  if (async_invoke->conversion) async_invoke->conversion->Release(env);
+  status = napi_delete_reference(env, async_invoke->keep_alive);
+  assert(status == napi_ok);
+  delete async_invoke;
+}
+
+napi_value Homegear::CreateError(napi_env env, const Ipc::PVariable &error) {
+  napi_value code;
+  auto status = napi_create_string_utf8(env, std::to_string(error->structValue->at("faultCode")->integerValue).c_str(), NAPI_AUTO_LENGTH, &code);
+  assert(status == napi_ok);
+  napi_value message;
+  status = napi_create_string_utf8(env, error->structValue->at("faultString")->stringValue.c_str(), NAPI_AUTO_LENGTH, &message);
+  assert(status == napi_ok);
+  napi_value result;
+  status = napi_create_error(env, code, message, &result);
+  assert(status == napi_ok);
+  return result;
+}
+
+void Homegear::QueueOfflineInvoke(napi_env env, AsyncInvoke *async_invoke, int64_t timeout) {
+  if (offline_queue_.size() >= offline_queue_size_) {
+    offline_rejected_++;
+    FinishAsyncInvoke(env, async_invoke, nullptr, CreateError(env, Ipc::Variable::createError(-32501, "Not connected to Homegear and the offline queue is full.")));
+    return;
+  }
+
+  async_invoke->deadline = Ipc::HelperFunctions::getTime() + timeout;
+  offline_queue_.push_back(async_invoke);
+  offline_queued_++;
+  ScheduleOfflineQueueExpiry(env);
+}
+
+void Homegear::FlushOfflineQueue(napi_env env) {
+  if (offline_queue_.empty()) return;
+
+  ClearOfflineQueueTimer(env);
+
+  //All requests are queued at once, so they are sent to Homegear concurrently from the libuv thread pool instead of
+  //one round trip after the other.
+  std::deque<AsyncInvoke *> offline_queue;
+  offline_queue.swap(offline_queue_);
+  auto time = Ipc::HelperFunctions::getTime();
+  for (auto *async_invoke : offline_queue) {
+    if (async_invoke->deadline <= time) {
+      offline_expired_++;
+      FinishAsyncInvoke(env, async_invoke, nullptr, CreateError(env, Ipc::Variable::createError(-32502, "Request timed out while not connected to Homegear.")));
+      continue;
+    }
+    offline_flushed_++;
+    async_invoke->deadline = 0;
+    StartAsyncInvoke(env, async_invoke);
+  }
+}
+
+void Homegear::ExpireOfflineInvokes(napi_env env) {
+  auto time = Ipc::HelperFunctions::getTime();
+  for (auto async_invoke_iterator = offline_queue_.begin(); async_invoke_iterator != offline_queue_.end();) {
+    if ((*async_invoke_iterator)->deadline <= time) {
+      offline_expired_++;
+      FinishAsyncInvoke(env, *async_invoke_iterator, nullptr, CreateError(env, Ipc::Variable::createError(-32502, "Request timed out while not connected to Homegear.")));
+      async_invoke_iterator = offline_queue_.erase(async_invoke_iterator);
+    } else {
+      async_invoke_iterator++;
+    }
+  }
+}
+
+void Homegear::ClearOfflineQueueTimer(napi_env env) {
+  if (!offline_queue_timer_) return;
+
+  napi_value global;
+  auto status = napi_get_global(env, &global);
+  assert(status == napi_ok);
+  napi_value clear_timeout;
+  status = napi_get_named_property(env, global, "clearTimeout", &clear_timeout);
+  assert(status == napi_ok);
+  napi_value timer;
+  status = napi_get_reference_value(env, offline_queue_timer_, &timer);
+  assert(status == napi_ok);
+  status = napi_call_function(env, global, clear_timeout, 1, &timer, nullptr);
+  assert(status == napi_ok);
+  status = napi_delete_reference(env, offline_queue_timer_);
+  assert(status == napi_ok);
+  offline_queue_timer_ = nullptr;
+}
+
+void Homegear::ScheduleOfflineQueueExpiry(napi_env env) {
+  //There is at most one timer. It is only pending while the queue is not empty, as the queued requests keep this object alive.
+  if (offline_queue_.empty()) return;
+
+  int64_t next_deadline = offline_queue_.front()->deadline;
+  for (auto *async_invoke : offline_queue_) {
+    if (async_invoke->deadline < next_deadline) next_deadline = async_invoke->deadline;
+  }
+
+  //A request with a shorter timeout than the ones queued before needs an earlier timer.
+  if (offline_queue_timer_) {
+    if (next_deadline >= offline_queue_timer_deadline_) return;
+    ClearOfflineQueueTimer(env);
+  }
+
+  napi_value global;
+  auto status = napi_get_global(env, &global);
+  assert(status == napi_ok);
+  napi_value set_timeout;
+  status = napi_get_named_property(env, global, "setTimeout", &set_timeout);
+  assert(status == napi_ok);
+  napi_value args[2];
+  status = napi_create_function(env, "expireOfflineQueue", NAPI_AUTO_LENGTH, OnOfflineQueueExpiry, this, &args[0]);
+  assert(status == napi_ok);
+  status = napi_create_int64(env, std::max((int64_t)0, next_deadline - Ipc::HelperFunctions::getTime()), &args[1]);
+  assert(status == napi_ok);
+  napi_value timer;
+  status = napi_call_function(env, global, set_timeout, 2, args, &timer);
+  assert(status == napi_ok);
+
+  //The timer alone must not keep the process running.
+  napi_value unref;
+  status = napi_get_named_property(env, timer, "unref", &unref);
+  assert(status == napi_ok);
+  status = napi_call_function(env, timer, unref, 0, nullptr, nullptr);
+  assert(status == napi_ok);
+
+  status = napi_create_reference(env, timer, 1, &offline_queue_timer_);
+  assert(status == napi_ok);
+  offline_queue_timer_deadline_ = next_deadline;
+}
+
+napi_value Homegear::OnOfflineQueueExpiry(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  void *data = nullptr;
+  auto status = napi_get_cb_info(env, info, &argc, nullptr, nullptr, &data);
+  assert(status == napi_ok);
+
+  auto obj = (Homegear *)data;
+  if (obj->offline_queue_timer_) {
+    status = napi_delete_reference(env, obj->offline_queue_timer_);
+    assert(status == napi_ok);
+    obj->offline_queue_timer_ = nullptr;
+  }
+  obj->ExpireOfflineInvokes(env);
+  obj->ScheduleOfflineQueueExpiry(env);
+
+  return nullptr;
+}
+
+napi_value Homegear::Connected(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, nullptr, &jsthis, nullptr);
+  assert(status == napi_ok);
 
   Homegear *obj;
   status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
@@ -471,4 +1533,695 @@ napi_value Homegear::Connected(napi_env env, napi_callback_info info) {
   return result;
 }
 
+napi_value Homegear::RegisterVariable(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  if (argc != 3) {
+    status = napi_throw_type_error(env, "-1", "Wrong parameter count. Expected peer ID, channel and variable name.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  auto peer_id = NapiVariableConverter::getVariable(env, args[0]);
+  auto channel = NapiVariableConverter::getVariable(env, args[1]);
+  auto variable_name = NapiVariableConverter::getVariable(env, args[2]);
+
+  if (variable_name->stringValue.empty()) {
+    status = napi_throw_type_error(env, "-1", "variableName is not a String or empty.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  napi_value result;
+  status = napi_create_uint32(env, obj->variable_handles_.Register((uint64_t)peer_id->integerValue64, (int32_t)channel->integerValue64, variable_name->stringValue), &result);
+  assert(status == napi_ok);
+
+  return result;
+}
+
+napi_value Homegear::UnregisterVariable(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  auto handle = NapiVariableConverter::getVariable(env, args[0]);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  napi_value result;
+  status = napi_get_boolean(env, handle->integerValue64 >= 0 && obj->variable_handles_.Unregister((uint32_t)handle->integerValue64), &result);
+  assert(status == napi_ok);
+
+  return result;
+}
+
+napi_value Homegear::SetVariableEventCallback(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  napi_valuetype valuetype;
+  status = napi_typeof(env, args[0], &valuetype);
+  assert(status == napi_ok);
+  if (valuetype != napi_function) {
+    status = napi_throw_type_error(env, "-1", "callback is not a function.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  //The thread-safe function is used by the IPC threads without synchronization, so it can't be replaced once set.
+  if (obj->on_variable_event_threadsafe_function_) {
+    status = napi_throw_error(env, "-1", "Variable event callback is already set.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  napi_value resource_name;
+  status = napi_create_string_utf8(env, "Thread-safe call from OnEvent() for registered variables", NAPI_AUTO_LENGTH, &resource_name);
+  assert(status == napi_ok);
+  napi_threadsafe_function on_variable_event_threadsafe_function = nullptr;
+  status = napi_create_threadsafe_function(env, args[0], nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnVariableEventJs, &on_variable_event_threadsafe_function);
+  assert(status == napi_ok);
+  status = napi_unref_threadsafe_function(env, on_variable_event_threadsafe_function); //Allow destruction of process even though the reference counter is not 0
+  assert(status == napi_ok);
+  obj->on_variable_event_threadsafe_function_ = on_variable_event_threadsafe_function;
+
+  return nullptr;
+}
+
+napi_value Homegear::TakeSnapshot(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  auto *async_snapshot = new AsyncSnapshot;
+  async_snapshot->obj = obj;
+  //Values are only stored with resync enabled. Without them, all values are fetched from Homegear.
+  async_snapshot->fetch = !obj->resync_ || !obj->initial_sync_done_;
+  if (argc == 1 && GetOption(NapiVariableConverter::getVariable(env, args[0]), "fetch")->booleanValue) async_snapshot->fetch = true;
+  //Keep this object alive until the Promise is settled.
+  status = napi_create_reference(env, jsthis, 1, &async_snapshot->keep_alive);
+  assert(status == napi_ok);
+
+  napi_value promise;
+  status = napi_create_promise(env, &async_snapshot->deferred, &promise);
+  assert(status == napi_ok);
+
+  napi_value resource_name;
+  status = napi_create_string_utf8(env, "Homegear.snapshot()", NAPI_AUTO_LENGTH, &resource_name);
+  assert(status == napi_ok);
+  status = napi_create_async_work(env, nullptr, resource_name, ExecuteSnapshot, CompleteSnapshot, async_snapshot, &async_snapshot->work);
+  assert(status == napi_ok);
+  status = napi_queue_async_work(env, async_snapshot->work);
+  assert(status == napi_ok);
+
+  return promise;
+}
+
+void Homegear::ExecuteSnapshot(napi_env env, void *data) {
+  auto *async_snapshot = (AsyncSnapshot *)data;
+  auto &snapshot = async_snapshot->snapshot;
+  auto add_value = [&snapshot](uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value) {
+    snapshot.Add(peer_id, channel, variable_name, value);
+  };
+
+  if (!async_snapshot->fetch) {
+    async_snapshot->obj->value_store_.ForEach(add_value);
+    return;
+  }
+
+  auto parameters = std::make_shared<Ipc::Array>();
+  auto all_values = async_snapshot->obj->ipc_client_->invoke("getAllValues", parameters);
+  if (all_values->errorStruct) {
+    async_snapshot->error = all_values;
+    return;
+  }
+  if (!ValueStore::ForEachValue(all_values, add_value)) async_snapshot->error = Ipc::Variable::createError(-32500, "Unexpected result of getAllValues.");
+}
+
+void Homegear::CompleteSnapshot(napi_env env, napi_status status, void *data) {
+  auto *async_snapshot = (AsyncSnapshot *)data;
+  napi_delete_async_work(env, async_snapshot->work);
+
+  if (status != napi_ok && !async_snapshot->error) async_snapshot->error = Ipc::Variable::createError(-32500, "Unknown application error.");
+  if (async_snapshot->error) {
+    status = napi_reject_deferred(env, async_snapshot->deferred, CreateError(env, async_snapshot->error));
+  } else {
+    status = napi_resolve_deferred(env, async_snapshot->deferred, async_snapshot->snapshot.ToNapi(env));
+  }
+  assert(status == napi_ok);
+
+  status = napi_delete_reference(env, async_snapshot->keep_alive);
+  assert(status == napi_ok);
+  delete async_snapshot;
+}
+
+napi_value Homegear::StartTracing(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  int64_t buffer_size = 100000;
+  if (argc == 1) {
+    auto buffer_size_option = GetOption(NapiVariableConverter::getVariable(env, args[0]), "bufferSize");
+    if (buffer_size_option->type == Ipc::VariableType::tInteger || buffer_size_option->type == Ipc::VariableType::tInteger64) buffer_size = buffer_size_option->integerValue64;
+    if (buffer_size < 0) {
+      status = napi_throw_range_error(env, "-1", "bufferSize must not be negative.");
+      assert(status == napi_ok);
+      return nullptr;
+    }
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  obj->tracer_.Start((size_t)buffer_size);
+
+  return nullptr;
+}
+
+napi_value Homegear::StopTracing(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, nullptr, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  auto trace = obj->tracer_.Stop();
+
+  napi_value result;
+  status = napi_create_string_utf8(env, trace.c_str(), trace.size(), &result);
+  assert(status == napi_ok);
+
+  return result;
+}
+
+napi_value Homegear::StartRecording(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  auto path = NapiVariableConverter::getVariable(env, args[0]);
+  if (path->stringValue.empty()) {
+    status = napi_throw_type_error(env, "-1", "path is not a String or empty.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  auto recorder = std::make_shared<EventLogWriter>();
+  std::string error;
+  if (!recorder->Open(path->stringValue, error)) {
+    status = napi_throw_error(env, "-1", error.c_str());
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  auto previous_recorder = obj->ipc_client_->SetRecorder(recorder);
+  if (previous_recorder) previous_recorder->Close();
+
+  return nullptr;
+}
+
+napi_value Homegear::StopRecording(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, nullptr, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  uint64_t packets = 0;
+  auto recorder = obj->ipc_client_->SetRecorder(nullptr);
+  if (recorder) {
+    recorder->Close();
+    packets = recorder->PacketCount();
+  }
+
+  napi_value result;
+  status = napi_create_int64(env, (int64_t)packets, &result);
+  assert(status == napi_ok);
+
+  return result;
+}
+
+napi_value Homegear::Replay(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  if (argc < 1) {
+    status = napi_throw_type_error(env, "-1", "Wrong parameter count. Expected path and optionally options.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  auto path = NapiVariableConverter::getVariable(env, args[0]);
+  if (path->stringValue.empty()) {
+    status = napi_throw_type_error(env, "-1", "path is not a String or empty.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  double speed = 1;
+  if (argc == 2) {
+    auto speed_option = GetOption(NapiVariableConverter::getVariable(env, args[1]), "speed");
+    if (speed_option->type == Ipc::VariableType::tFloat) speed = speed_option->floatValue;
+    else if (speed_option->type == Ipc::VariableType::tInteger || speed_option->type == Ipc::VariableType::tInteger64) speed = (double)speed_option->integerValue64;
+    if (speed < 0) {
+      status = napi_throw_range_error(env, "-1", "speed must not be negative.");
+      assert(status == napi_ok);
+      return nullptr;
+    }
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  //The thread is joined by OnReplayFinishedJs(), so it is only joinable while a replay is running.
+  if (obj->replay_thread_.joinable()) {
+    status = napi_throw_error(env, "-1", "A replay is already running.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  auto *async_replay = new AsyncReplay;
+  async_replay->obj = obj;
+  async_replay->path = path->stringValue;
+  async_replay->speed = speed;
+  //Keep this object alive until the replay is finished.
+  status = napi_create_reference(env, jsthis, 1, &async_replay->keep_alive);
+  assert(status == napi_ok);
+
+  napi_value promise;
+  status = napi_create_promise(env, &async_replay->deferred, &promise);
+  assert(status == napi_ok);
+
+  //Not unref'd, so the process keeps running until the replay is finished.
+  napi_value resource_name;
+  status = napi_create_string_utf8(env, "Thread-safe call from RunReplay()", NAPI_AUTO_LENGTH, &resource_name);
+  assert(status == napi_ok);
+  status = napi_create_threadsafe_function(env, nullptr, nullptr, resource_name, 0, 1, nullptr, nullptr, obj, OnReplayFinishedJs, &async_replay->finished);
+  assert(status == napi_ok);
+
+  {
+    std::lock_guard<std::mutex> replay_guard(obj->replay_mutex_);
+    obj->stop_replay_ = false;
+  }
+  //A separate thread, as a replay at original speed sleeps most of the time and would block a libuv thread pool thread.
+  obj->replay_thread_ = std::thread(&Homegear::RunReplay, obj, async_replay);
+
+  return promise;
+}
+
+napi_value Homegear::StopReplay(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, nullptr, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  {
+    std::lock_guard<std::mutex> replay_guard(obj->replay_mutex_);
+    obj->stop_replay_ = true;
+  }
+  obj->replay_condition_.notify_all();
+
+  return nullptr;
+}
+
+void Homegear::RunReplay(AsyncReplay *async_replay) {
+  EventLogReader reader;
+  if (reader.Open(async_replay->path, async_replay->error)) {
+    //The packets are passed to the same callbacks as live packets, so backpressure applies at maximum speed, too.
+    auto start_time = std::chrono::steady_clock::now();
+    int64_t time = 0;
+    std::string method_name;
+    Ipc::PArray parameters;
+    while (reader.Next(time, method_name, parameters)) {
+      {
+        std::unique_lock<std::mutex> replay_lock(replay_mutex_);
+        if (async_replay->speed > 0) {
+          replay_condition_.wait_until(replay_lock, start_time + std::chrono::microseconds((int64_t)((double)time / async_replay->speed)), [&] {
+            return stop_replay_ || disposing_;
+          });
+        }
+        if (stop_replay_ || disposing_) break;
+      }
+      ipc_client_->Replay(method_name, parameters);
+      async_replay->packets++;
+    }
+  }
+
+  auto status = napi_call_threadsafe_function(async_replay->finished, async_replay, napi_tsfn_blocking);
+  assert(status == napi_ok);
+  status = napi_release_threadsafe_function(async_replay->finished, napi_tsfn_release);
+  assert(status == napi_ok);
+}
+
+void Homegear::OnReplayFinishedJs(napi_env env, napi_value callback, void *context, void *data) {
+  auto *async_replay = (AsyncReplay *)data;
+  if (env && context) {
+    auto obj = static_cast<Homegear *>(context);
+    if (obj->replay_thread_.joinable()) obj->replay_thread_.join();
+
+    napi_status status;
+    if (!async_replay->error.empty()) {
+      napi_value code;
+      status = napi_create_string_utf8(env, "-1", NAPI_AUTO_LENGTH, &code);
+      assert(status == napi_ok);
+      napi_value message;
+      status = napi_create_string_utf8(env, async_replay->error.c_str(), NAPI_AUTO_LENGTH, &message);
+      assert(status == napi_ok);
+      napi_value error;
+      status = napi_create_error(env, code, message, &error);
+      assert(status == napi_ok);
+      status = napi_reject_deferred(env, async_replay->deferred, error);
+      assert(status == napi_ok);
+    } else {
+      napi_value result;
+      status = napi_create_int64(env, (int64_t)async_replay->packets, &result);
+      assert(status == napi_ok);
+      status = napi_resolve_deferred(env, async_replay->deferred, result);
+      assert(status == napi_ok);
+    }
+
+    status = napi_delete_reference(env, async_replay->keep_alive);
+    assert(status == napi_ok);
+  }
+
+  delete async_replay;
+}
+
+napi_value Homegear::RegisterAggregator(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  if (argc != 4) {
+    status = napi_throw_type_error(env, "-1", "Wrong parameter count. Expected peer ID, channel, variable name and options.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  auto peer_id = NapiVariableConverter::getVariable(env, args[0]);
+  auto channel = NapiVariableConverter::getVariable(env, args[1]);
+  auto variable_name = NapiVariableConverter::getVariable(env, args[2]);
+  auto options = NapiVariableConverter::getVariable(env, args[3]);
+
+  if (variable_name->stringValue.empty()) {
+    status = napi_throw_type_error(env, "-1", "variableName is not a String or empty.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  //Fractional milliseconds are rounded.
+  auto to_milliseconds = [](const Ipc::PVariable &value) {
+    return value->type == Ipc::VariableType::tFloat ? (int64_t)std::llround(value->floatValue) : value->integerValue64;
+  };
+  auto window = to_milliseconds(GetOption(options, "window"));
+  if (window <= 0) {
+    status = napi_throw_type_error(env, "-1", "window is not a positive Number.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  napi_value callback;
+  status = napi_get_named_property(env, args[3], "callback", &callback);
+  assert(status == napi_ok);
+  napi_valuetype valuetype;
+  status = napi_typeof(env, callback, &valuetype);
+  assert(status == napi_ok);
+  if (valuetype != napi_function) {
+    status = napi_throw_type_error(env, "-1", "callback is not a function.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  napi_ref callback_reference;
+  status = napi_create_reference(env, callback, 1, &callback_reference);
+  assert(status == napi_ok);
+  auto aggregator_id = obj->aggregation_engine_->Add((uint64_t)peer_id->integerValue64,
+                                                     (int32_t)channel->integerValue64,
+                                                     variable_name->stringValue,
+                                                     window,
+                                                     to_milliseconds(GetOption(options, "step")),
+                                                     GetOption(options, "passThrough")->booleanValue);
+  obj->aggregator_callbacks_.emplace(aggregator_id, callback_reference);
+
+  napi_value result;
+  status = napi_create_uint32(env, aggregator_id, &result);
+  assert(status == napi_ok);
+
+  return result;
+}
+
+napi_value Homegear::UnregisterAggregator(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  auto aggregator_id = NapiVariableConverter::getVariable(env, args[0]);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  bool removed = false;
+  auto callback_iterator = obj->aggregator_callbacks_.find((uint32_t)aggregator_id->integerValue64);
+  if (aggregator_id->integerValue64 >= 0 && callback_iterator != obj->aggregator_callbacks_.end()) {
+    removed = obj->aggregation_engine_->Remove(callback_iterator->first);
+    status = napi_delete_reference(env, callback_iterator->second);
+    assert(status == napi_ok);
+    obj->aggregator_callbacks_.erase(callback_iterator);
+  }
+
+  napi_value result;
+  status = napi_get_boolean(env, removed, &result);
+  assert(status == napi_ok);
+
+  return result;
+}
+
+napi_value Homegear::RegisterNode(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  if (argc != 2) {
+    status = napi_throw_type_error(env, "-1", "Wrong parameter count. Expected node ID and handlers.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  auto node_id = NapiVariableConverter::getVariable(env, args[0]);
+  if (node_id->stringValue.empty()) {
+    status = napi_throw_type_error(env, "-1", "nodeId is not a String or empty.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  napi_valuetype valuetype;
+  status = napi_typeof(env, args[1], &valuetype);
+  assert(status == napi_ok);
+  if (valuetype != napi_object) {
+    status = napi_throw_type_error(env, "-1", "handlers is not an Object.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  auto node = std::make_shared<NodeRegistration>();
+  node->node_id = node_id->stringValue;
+
+  napi_value input;
+  status = napi_get_named_property(env, args[1], "input", &input);
+  assert(status == napi_ok);
+  status = napi_typeof(env, input, &valuetype);
+  assert(status == napi_ok);
+  if (valuetype == napi_function) {
+    status = napi_create_reference(env, input, 1, &node->input);
+    assert(status == napi_ok);
+    node->has_input = true;
+  }
+
+  napi_value methods;
+  status = napi_get_named_property(env, args[1], "methods", &methods);
+  assert(status == napi_ok);
+  status = napi_typeof(env, methods, &valuetype);
+  assert(status == napi_ok);
+  if (valuetype == napi_object) {
+    status = napi_create_reference(env, methods, 1, &node->methods);
+    assert(status == napi_ok);
+  }
+
+  napi_value max_in_flight;
+  status = napi_get_named_property(env, args[1], "maxInFlight", &max_in_flight);
+  assert(status == napi_ok);
+  auto max_in_flight_variable = NapiVariableConverter::getVariable(env, max_in_flight);
+  if (max_in_flight_variable->integerValue64 > 0) node->max_in_flight = (uint32_t)max_in_flight_variable->integerValue64;
+
+  PNodeRegistration old_node;
+  {
+    std::lock_guard<std::mutex> nodes_guard(obj->nodes_mutex_);
+    auto &element = obj->nodes_[node->node_id];
+    old_node = element;
+    element = node;
+  }
+  if (old_node) obj->DeleteNode(old_node);
+
+  return nullptr;
+}
+
+napi_value Homegear::UnregisterNode(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  auto node_id = NapiVariableConverter::getVariable(env, args[0]);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  PNodeRegistration node;
+  {
+    std::lock_guard<std::mutex> nodes_guard(obj->nodes_mutex_);
+    auto node_iterator = obj->nodes_.find(node_id->stringValue);
+    if (node_iterator != obj->nodes_.end()) {
+      node = node_iterator->second;
+      obj->nodes_.erase(node_iterator);
+    }
+  }
+  if (node) obj->DeleteNode(node);
+
+  napi_value result;
+  status = napi_get_boolean(env, (bool)node, &result);
+  assert(status == napi_ok);
+
+  return result;
+}
+
+napi_value Homegear::SetWatchdogCallback(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[argc];
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, args, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  napi_valuetype valuetype;
+  status = napi_typeof(env, args[0], &valuetype);
+  assert(status == napi_ok);
+  if (valuetype != napi_function) {
+    status = napi_throw_type_error(env, "-1", "callback is not a function.");
+    assert(status == napi_ok);
+    return nullptr;
+  }
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
+
+  if (obj->watchdog_callback_) {
+    status = napi_delete_reference(env, obj->watchdog_callback_);
+    assert(status == napi_ok);
+  }
+  status = napi_create_reference(env, args[0], 1, &obj->watchdog_callback_);
+  assert(status == napi_ok);
+
+  return nullptr;
+}
+
+napi_value Homegear::GetStats(napi_env env, napi_callback_info info) {
+  size_t argc = 0;
+  napi_value jsthis;
+  auto status = napi_get_cb_info(env, info, &argc, nullptr, &jsthis, nullptr);
+  assert(status == napi_ok);
+
+  Homegear *obj;
+  status = napi_unwrap(env, jsthis, reinterpret_cast<void **>(&obj));
+  assert(status == napi_ok);
 
+  auto stats = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+  stats->structValue->emplace("queue", obj->backpressure_.GetStats());
+  stats->structValue->emplace("cache", obj->result_cache_.GetStats());
+
+  auto resync_stats = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+  resync_stats->structValue->emplace("count", std::make_shared<Ipc::Variable>((int64_t)obj->resync_count_));
+  resync_stats->structValue->emplace("changedValues", std::make_shared<Ipc::Variable>((int64_t)obj->resync_changed_values_));
+  resync_stats->structValue->emplace("lastDuration", std::make_shared<Ipc::Variable>((int64_t)obj->resync_duration_));
+  stats->structValue->emplace("resync", resync_stats);
+
+  auto offline_queue_stats = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+  offline_queue_stats->structValue->emplace("size", std::make_shared<Ipc::Variable>((int64_t)obj->offline_queue_.size()));
+  offline_queue_stats->structValue->emplace("maxSize", std::make_shared<Ipc::Variable>((int64_t)obj->offline_queue_size_));
+  offline_queue_stats->structValue->emplace("queued", std::make_shared<Ipc::Variable>((int64_t)obj->offline_queued_));
+  offline_queue_stats->structValue->emplace("flushed", std::make_shared<Ipc::Variable>((int64_t)obj->offline_flushed_));
+  offline_queue_stats->structValue->emplace("expired", std::make_shared<Ipc::Variable>((int64_t)obj->offline_expired_));
+  offline_queue_stats->structValue->emplace("rejected", std::make_shared<Ipc::Variable>((int64_t)obj->offline_rejected_));
+  stats->structValue->emplace("offlineQueue", offline_queue_stats);
+
+  auto watchdog_stats = obj->watchdog_.GetStats();
+  watchdog_stats->structValue->emplace("timedOutNodeMethods", std::make_shared<Ipc::Variable>((int64_t)obj->timed_out_node_methods_));
+  stats->structValue->emplace("watchdog", watchdog_stats);
+
+  return NapiVariableConverter::getNapiVariable(env, stats);
+}
\ No newline at end of file
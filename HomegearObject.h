@@ -6,8 +6,24 @@
 #define HOMEGEAR_NODEJS__HOMEGEAROBJECT_H_
 
 #include <node_api.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include "AggregationEngine.h"
+#include "Backpressure.h"
 #include "IpcClient.h"
+#include "NapiVariableConverter.h"
+#include "ResultCache.h"
+#include "Snapshot.h"
+#include "Tracer.h"
+#include "ValueStore.h"
+#include "VariableHandleTable.h"
+#include "Watchdog.h"
 
 class Homegear {
  public:
@@ -21,51 +37,253 @@ class Homegear {
     int32_t channel = -1;
     std::string variable_name;
     Ipc::PVariable value;
+    bool resync = false;
+    int64_t enqueue_time = 0;
   };
 
+  struct OnVariableEventStruct {
+    uint32_t handle = 0;
+    uint32_t generation = 0;
+    Ipc::PVariable value;
+    bool resync = false;
+    int64_t enqueue_time = 0;
+  };
+
+  struct NodeRegistration {
+    std::string node_id;
+    bool has_input = false;
+    std::atomic_bool registered{true};
+    // {{{ In-flight inputs of this node. Only limited when max_in_flight is not 0.
+    uint32_t max_in_flight = 0;
+    std::mutex in_flight_mutex;
+    std::condition_variable in_flight_condition;
+    uint32_t in_flight = 0;
+    // }}}
+    // {{{ Only accessed from the JavaScript thread
+    napi_ref input = nullptr;
+    napi_ref methods = nullptr;
+    napi_ref node_info = nullptr;
+    Ipc::PVariable node_info_source;
+    // }}}
+  };
+  typedef std::shared_ptr<NodeRegistration> PNodeRegistration;
+
   struct OnNodeInputStruct {
+    PNodeRegistration node;
+    pthread_t thread_id;
+    uint64_t request_id = 0; //Only set for synchronous inputs
     std::string node_id;
     Ipc::PVariable node_info;
     uint32_t input_index;
     Ipc::PVariable message;
     bool synchronous = false;
+    int64_t enqueue_time = 0;
+  };
+
+  struct PendingResult {
+    std::function<void(const Ipc::PVariable &result)> finish;
+    bool convert_result = false;
+    napi_ref keep_alive = nullptr;
+  };
+
+  struct AsyncInvoke {
+    Homegear *obj = nullptr;
+    std::string method;
+    Ipc::PArray parameters;
+    Ipc::PVariable result;
+    napi_deferred deferred = nullptr;
+    napi_async_work work = nullptr;
+    napi_ref keep_alive = nullptr;
+    std::unique_ptr<NapiVariableConverter::Conversion> conversion;
+    int64_t deadline = 0; //Only set while in the offline queue
+  };
+
+  struct AsyncReplay {
+    Homegear *obj = nullptr;
+    std::string path;
+    double speed = 1;
+    uint64_t packets = 0;
+    std::string error;
+    napi_deferred deferred = nullptr;
+    napi_threadsafe_function finished = nullptr;
+    napi_ref keep_alive = nullptr;
+  };
+
+  struct AsyncSnapshot {
+    Homegear *obj = nullptr;
+    bool fetch = false;
+    Snapshot snapshot;
+    Ipc::PVariable error;
+    napi_deferred deferred = nullptr;
+    napi_async_work work = nullptr;
+    napi_ref keep_alive = nullptr;
   };
 
   struct OnInvokeNodeMethodStruct {
+    PNodeRegistration node;
     pthread_t thread_id;
     std::string node_id;
     std::string method_name;
     Ipc::PVariable parameters;
+    int64_t enqueue_time = 0;
+    uint64_t request_id = 0;
+  };
+
+  struct PendingNodeMethod {
+    uint64_t request_id = 0;
+    int64_t start_time = 0;
   };
 
-  explicit Homegear(const std::string &socket_path);
+  Homegear(const std::string &socket_path, const Ipc::PVariable &options);
   ~Homegear();
 
   static napi_value New(napi_env env, napi_callback_info info);
   static inline napi_value Constructor(napi_env env);
+  static Ipc::PVariable GetOption(const Ipc::PVariable &options, const std::string &name);
 
   static napi_value Connected(napi_env env, napi_callback_info info);
   static napi_value Invoke(napi_env env, napi_callback_info info);
+  /**
+   * Invokes the RPC method in Homegear or returns the cached result. Called from the JavaScript and the worker threads.
+   */
+  Ipc::PVariable InvokeCached(const std::string &method, const Ipc::PArray &parameters);
+  static napi_value InvokeAsync(napi_env env, napi_callback_info info);
+  static void StartAsyncInvoke(napi_env env, AsyncInvoke *async_invoke);
+  static void ExecuteAsyncInvoke(napi_env env, void *data);
+  static void CompleteAsyncInvoke(napi_env env, napi_status status, void *data);
+  static void ContinueAsyncInvokeConversion(napi_env env, AsyncInvoke *async_invoke);
+  static napi_value OnContinueAsyncInvokeConversion(napi_env env, napi_callback_info info);
+  static void FinishAsyncInvoke(napi_env env, AsyncInvoke *async_invoke, napi_value result, napi_value error);
+  static napi_value CreateError(napi_env env, const Ipc::PVariable &error);
+  void QueueOfflineInvoke(napi_env env, AsyncInvoke *async_invoke, int64_t timeout);
+  void FlushOfflineQueue(napi_env env);
+  void ExpireOfflineInvokes(napi_env env);
+  void ScheduleOfflineQueueExpiry(napi_env env);
+  void ClearOfflineQueueTimer(napi_env env);
+  static napi_value OnOfflineQueueExpiry(napi_env env, napi_callback_info info);
+  static napi_value GetStats(napi_env env, napi_callback_info info);
+  static napi_value RegisterVariable(napi_env env, napi_callback_info info);
+  static napi_value UnregisterVariable(napi_env env, napi_callback_info info);
+  static napi_value SetVariableEventCallback(napi_env env, napi_callback_info info);
+  static napi_value TakeSnapshot(napi_env env, napi_callback_info info);
+  static void ExecuteSnapshot(napi_env env, void *data);
+  static void CompleteSnapshot(napi_env env, napi_status status, void *data);
+  static napi_value StartTracing(napi_env env, napi_callback_info info);
+  static napi_value StopTracing(napi_env env, napi_callback_info info);
+  static napi_value StartRecording(napi_env env, napi_callback_info info);
+  static napi_value StopRecording(napi_env env, napi_callback_info info);
+  static napi_value Replay(napi_env env, napi_callback_info info);
+  static napi_value StopReplay(napi_env env, napi_callback_info info);
+  void RunReplay(AsyncReplay *async_replay);
+  static void OnReplayFinishedJs(napi_env env, napi_value callback, void *context, void *data);
+  static napi_value RegisterAggregator(napi_env env, napi_callback_info info);
+  static napi_value UnregisterAggregator(napi_env env, napi_callback_info info);
+  static napi_value RegisterNode(napi_env env, napi_callback_info info);
+  static napi_value SetWatchdogCallback(napi_env env, napi_callback_info info);
+  static napi_value UnregisterNode(napi_env env, napi_callback_info info);
 
   static void OnConnectJs(napi_env env, napi_value callback, void *context, void *data);
   void OnConnect();
   static void OnDisconnectJs(napi_env env, napi_value callback, void *context, void *data);
   void OnDisconnect();
+  void OnDevicesChanged();
   static void OnEventJs(napi_env env, napi_value callback, void *context, void *data);
   void OnEvent(std::string &event_source, uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value);
+  void DispatchEvent(const std::string &event_source, uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value, bool resync);
+  void Resync();
+  static void OnVariableEventJs(napi_env env, napi_value callback, void *context, void *data);
+  static void OnAggregateJs(napi_env env, napi_value callback, void *context, void *data);
+  void OnAggregate(const AggregationEngine::Summary &summary);
   static void OnNodeInputJs(napi_env env, napi_value callback, void *context, void *data);
-  void OnNodeInput(const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous);
+  bool OnNodeInput(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous);
+  void FinishNodeInput(const PNodeRegistration &node, pthread_t thread_id, uint64_t request_id, bool synchronous, const Ipc::PVariable &result);
+  static void OnRegisteredNodeInputJs(napi_env env, napi_value callback, void *context, void *data);
   static void OnInvokeNodeMethodJs(napi_env env, napi_value callback, void *context, void *data);
-  bool OnInvokeNodeMethod(pthread_t thread_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters);
+  static void OnRegisteredNodeMethodJs(napi_env env, napi_value callback, void *context, void *data);
+  bool OnInvokeNodeMethod(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters);
+  bool IsNodeMethodPending(pthread_t thread_id, uint64_t request_id);
+  void FinishNodeMethod(pthread_t thread_id, uint64_t request_id, const Ipc::PVariable &result);
+  void ExpireNodeMethods();
+  void OnInvokeNodeMethodFinished(pthread_t thread_id);
+  static void OnWatchdogJs(napi_env env, napi_value callback, void *context, void *data);
+  void SendWatchdogHeartbeat();
+  /**
+   * Calls finish with the return value of a JavaScript handler. When the handler returned a Promise, finish is called
+   * once it is settled. When convert_result is false, only rejections are converted.
+   */
+  void SettleResult(napi_env env, napi_status call_status, napi_value value, bool convert_result, std::function<void(const Ipc::PVariable &result)> finish);
+  void TraceQueueTime(const char *category, int64_t enqueue_time);
+  static napi_value OnPromiseFulfilled(napi_env env, napi_callback_info info);
+  static napi_value OnPromiseRejected(napi_env env, napi_callback_info info);
+  PNodeRegistration GetNode(const std::string &node_id);
+  void DeleteNode(const PNodeRegistration &node);
 
   std::unique_ptr<IpcClient> ipc_client_;
+  uint32_t ipc_thread_count_ = 10;
   napi_threadsafe_function on_connect_threadsafe_function_ = nullptr;
   napi_threadsafe_function on_disconnect_threadsafe_function_ = nullptr;
   napi_threadsafe_function on_event_threadsafe_function_ = nullptr;
+  std::atomic<napi_threadsafe_function> on_variable_event_threadsafe_function_{nullptr};
   napi_threadsafe_function on_node_input_threadsafe_function_ = nullptr;
   napi_threadsafe_function on_invoke_node_method_threadsafe_function_ = nullptr;
+  napi_threadsafe_function on_registered_node_input_threadsafe_function_ = nullptr;
+  napi_threadsafe_function on_registered_node_method_threadsafe_function_ = nullptr;
+  napi_threadsafe_function on_aggregate_threadsafe_function_ = nullptr;
+  napi_threadsafe_function on_watchdog_threadsafe_function_ = nullptr;
   napi_env env_ = nullptr;
   napi_ref wrapper_ = nullptr;
+  std::atomic_bool disposing_{false};
+  Backpressure backpressure_;
+  Tracer tracer_;
+  ResultCache result_cache_;
+  NapiVariableConverter::Limits conversion_limits_;
+  std::chrono::microseconds conversion_time_slice_{5000};
+
+  // {{{ Offline queue of invokeAsync() calls. Only accessed from the JavaScript thread.
+  size_t offline_queue_size_ = 0;
+  int64_t offline_timeout_ = 30000;
+  std::deque<AsyncInvoke *> offline_queue_;
+  napi_ref offline_queue_timer_ = nullptr;
+  int64_t offline_queue_timer_deadline_ = 0;
+  uint64_t offline_queued_ = 0;
+  uint64_t offline_flushed_ = 0;
+  uint64_t offline_expired_ = 0;
+  uint64_t offline_rejected_ = 0;
+  // }}}
+
+  // {{{ Resync after reconnect
+  bool resync_ = false;
+  ValueStore value_store_;
+  std::mutex resync_thread_mutex_;
+  std::thread resync_thread_;
+  std::atomic_bool initial_sync_done_{false};
+  std::atomic_bool resync_attempted_{false};
+  std::atomic<uint64_t> resync_count_{0};
+  std::atomic<uint64_t> resync_changed_values_{0};
+  std::atomic<int64_t> resync_duration_{0};
+  // }}}
+  VariableHandleTable variable_handles_;
+  std::unique_ptr<AggregationEngine> aggregation_engine_;
+  std::unordered_map<uint32_t, napi_ref> aggregator_callbacks_; //Only accessed from the JavaScript thread
+  std::mutex nodes_mutex_;
+  std::unordered_map<std::string, PNodeRegistration> nodes_;
+
+  // {{{ Replay of recorded packets
+  std::mutex replay_mutex_;
+  std::condition_variable replay_condition_;
+  bool stop_replay_ = false;
+  std::thread replay_thread_; //Only started and joined on the JavaScript thread
+  // }}}
+
+  // {{{ Watchdog
+  Watchdog watchdog_;
+  int64_t watchdog_threshold_ = 0;
+  napi_ref watchdog_callback_ = nullptr; //Only accessed from the JavaScript thread
+  int64_t node_method_timeout_ = 0;
+  std::mutex pending_node_methods_mutex_;
+  std::unordered_map<pthread_t, PendingNodeMethod> pending_node_methods_;
+  std::atomic<uint64_t> timed_out_node_methods_{0};
+  // }}}
 };
 
 #endif //HOMEGEAR_NODEJS__HOMEGEAROBJECT_H_
@@ -40,15 +40,42 @@ IpcClient::IpcClient(const std::string &socketPath) : IIpcClient(socketPath) {
 IpcClient::~IpcClient() {
 }
 
+void IpcClient::SetCpuAffinity(const std::vector<int32_t> &cpus) {
+  CPU_ZERO(&cpu_affinity_);
+  for (auto cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpu_affinity_);
+  }
+  has_cpu_affinity_ = CPU_COUNT(&cpu_affinity_) > 0;
+}
+
+void IpcClient::ConfigureThread() {
+  if (!has_cpu_affinity_) return;
+  static thread_local const IpcClient *configured_for = nullptr;
+  if (configured_for == this) return;
+  configured_for = this;
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_affinity_) != 0) {
+    Ipc::Output::printWarning("Warning: Could not set CPU affinity of IPC thread.");
+  }
+}
+
 void IpcClient::onConnect() {
+  ConfigureThread();
+  if (reader_priority_ > 0) {
+    sched_param parameters{};
+    parameters.sched_priority = reader_priority_;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters) != 0) {
+      Ipc::Output::printWarning("Warning: Could not set priority of IPC reader thread.");
+    }
+  }
   if (on_connect_) on_connect_();
 }
 
 void IpcClient::onDisconnect() {
+  ConfigureThread();
   if (on_disconnect_) on_disconnect_();
 }
 
-void IpcClient::InvokeResult(pthread_t thread_id, const Ipc::PVariable &result) {
+void IpcClient::InvokeResult(pthread_t thread_id, uint64_t request_id, const Ipc::PVariable &result) {
   std::lock_guard<std::mutex> request_info_guard(local_request_info_mutex_);
   auto request_iterator = local_request_Info_.find(thread_id);
   if (request_iterator != local_request_Info_.end()) {
@@ -59,7 +86,7 @@ void IpcClient::InvokeResult(pthread_t thread_id, const Ipc::PVariable &result)
       auto result_iterator = invoke_results_.find(thread_id);
       if (result_iterator != invoke_results_.end()) {
         auto &element = result_iterator->second;
-        if (element) {
+        if (element && element->request_id == request_id) {
           element->finished = true;
           element->result = result;
         }
@@ -71,24 +98,75 @@ void IpcClient::InvokeResult(pthread_t thread_id, const Ipc::PVariable &result)
   }
 }
 
+std::shared_ptr<EventLogWriter> IpcClient::SetRecorder(const std::shared_ptr<EventLogWriter> &recorder) {
+  std::lock_guard<std::mutex> recorder_guard(recorder_mutex_);
+  auto previous_recorder = recorder_;
+  recorder_ = recorder;
+  recording_ = (bool)recorder;
+  return previous_recorder;
+}
+
+void IpcClient::Record(const std::string &method_name, Ipc::PArray &parameters) {
+  if (!recording_) return;
+  std::shared_ptr<EventLogWriter> recorder;
+  {
+    std::lock_guard<std::mutex> recorder_guard(recorder_mutex_);
+    recorder = recorder_;
+  }
+  if (recorder) recorder->Append(method_name, parameters);
+}
+
+void IpcClient::Replay(const std::string &method_name, Ipc::PArray &parameters) {
+  //The replay thread is not an IPC thread, so ConfigureThread() and Record() are skipped.
+  if (method_name == "broadcastEvent") {
+    if (parameters->size() != 5) return;
+    DispatchEvent(parameters);
+  } else if (method_name == "nodeInput") {
+    if (parameters->size() != 5) return;
+    parameters->at(4) = std::make_shared<Ipc::Variable>(false);
+    DispatchNodeInput(parameters);
+  }
+}
+
 // {{{ RPC methods
 Ipc::PVariable IpcClient::broadcastEvent(Ipc::PArray &parameters) {
   if (parameters->size() != 5) return Ipc::Variable::createError(-1, "Wrong parameter count.");
+  ConfigureThread();
+  Record("broadcastEvent", parameters);
+
+  return DispatchEvent(parameters);
+}
 
+Ipc::PVariable IpcClient::DispatchEvent(Ipc::PArray &parameters) {
   for (uint32_t i = 0; i < parameters->at(3)->arrayValue->size(); ++i) {
     if (broadcast_event_) broadcast_event_(parameters->at(0)->stringValue, (uint64_t)parameters->at(1)->integerValue64, parameters->at(2)->integerValue, parameters->at(3)->arrayValue->at(i)->stringValue, parameters->at(4)->arrayValue->at(i));
   }
 
   return std::make_shared<Ipc::Variable>();
 }
-// }}}
 
-// {{{ RPC methods when used in a Node-BLUE node
-Ipc::PVariable IpcClient::InvokeNodeMethod(Ipc::PArray &parameters) {
-  if (parameters->size() < 3) return Ipc::Variable::createError(-1, "Wrong parameter count.");
+Ipc::PVariable IpcClient::broadcastNewDevices(Ipc::PArray &parameters) {
+  return BroadcastDevicesChanged();
+}
 
-  if (!invoke_node_method_) return Ipc::Variable::createError(-1, "Unknown method (no callback method specified).");
+Ipc::PVariable IpcClient::broadcastDeleteDevices(Ipc::PArray &parameters) {
+  return BroadcastDevicesChanged();
+}
+
+Ipc::PVariable IpcClient::broadcastUpdateDevice(Ipc::PArray &parameters) {
+  return BroadcastDevicesChanged();
+}
+
+Ipc::PVariable IpcClient::BroadcastDevicesChanged() {
+  ConfigureThread();
+  if (devices_changed_) devices_changed_();
+
+  return std::make_shared<Ipc::Variable>();
+}
+// }}}
 
+// {{{ RPC methods when used in a Node-BLUE node
+Ipc::PVariable IpcClient::WaitForLocalResult(const std::string &method_name, const std::function<bool(pthread_t thread_id, uint64_t request_id)> &dispatch, const Ipc::PVariable &not_dispatched_result) {
   auto thread_id = pthread_self();
   PLocalRequestInfo request_info;
   std::unique_lock<std::mutex> request_info_guard(local_request_info_mutex_);
@@ -101,17 +179,21 @@ Ipc::PVariable IpcClient::InvokeNodeMethod(Ipc::PArray &parameters) {
   request_info_guard.unlock();
 
   PInvokeResultInfo result;
+  auto request_id = next_request_id_++;
   {
     std::lock_guard<std::mutex> result_guard(invoke_results_mutex_);
     auto result_iterator = invoke_results_.emplace(thread_id, std::make_shared<InvokeResultInfo>());
-    if (result_iterator.second) result = result_iterator.first->second;
+    if (result_iterator.second) {
+      result = result_iterator.first->second;
+      result->request_id = request_id;
+    }
   }
   if (!result) {
     Ipc::Output::printError("Critical: Could not insert local response struct into map.");
     return Ipc::Variable::createError(-32500, "Unknown application error.");
   }
 
-  if (invoke_node_method_(thread_id, parameters->at(0)->stringValue, parameters->at(1)->stringValue, parameters->at(2))) {
+  if (dispatch(thread_id, request_id)) {
     auto start_time = Ipc::HelperFunctions::getTime();
     std::unique_lock<std::mutex> wait_lock(request_info->wait_mutex);
     while (!request_info->condition_variable.wait_for(wait_lock, std::chrono::milliseconds(1000), [&] {
@@ -120,11 +202,11 @@ Ipc::PVariable IpcClient::InvokeNodeMethod(Ipc::PArray &parameters) {
   } else {
     //Not really an error
     result->finished = true;
-    result->result = Ipc::Variable::createError(-1, "Unknown method (no callback method specified).");
+    result->result = not_dispatched_result;
   }
 
   if (!result->finished) {
-    Ipc::Output::printError("Error: No response received to local RPC request. Method: invokeNodeMethod");
+    Ipc::Output::printError("Error: No response received to local RPC request. Method: " + method_name);
     result->result = Ipc::Variable::createError(-1, "No response received.");
   }
 
@@ -143,12 +225,41 @@ Ipc::PVariable IpcClient::InvokeNodeMethod(Ipc::PArray &parameters) {
   return return_value;
 }
 
+Ipc::PVariable IpcClient::InvokeNodeMethod(Ipc::PArray &parameters) {
+  if (parameters->size() < 3) return Ipc::Variable::createError(-1, "Wrong parameter count.");
+  ConfigureThread();
+
+  if (!invoke_node_method_) return Ipc::Variable::createError(-1, "Unknown method (no callback method specified).");
+
+  auto result = WaitForLocalResult("invokeNodeMethod", [&](pthread_t thread_id, uint64_t request_id) {
+    return invoke_node_method_(thread_id, request_id, parameters->at(0)->stringValue, parameters->at(1)->stringValue, parameters->at(2));
+  }, Ipc::Variable::createError(-1, "Unknown method (no callback method specified)."));
+  if (invoke_node_method_finished_) invoke_node_method_finished_(pthread_self());
+  return result;
+}
+
 Ipc::PVariable IpcClient::NodeInput(Ipc::PArray &parameters) {
   if (parameters->size() != 5) return Ipc::Variable::createError(-1, "Wrong parameter count.");
 
+  ConfigureThread();
+  Record("nodeInput", parameters);
+
+  return DispatchNodeInput(parameters);
+}
+
+Ipc::PVariable IpcClient::DispatchNodeInput(Ipc::PArray &parameters) {
   parameters->at(3)->structValue->emplace("inputIndex", parameters->at(2));
-  if (node_input_) node_input_(parameters->at(0)->stringValue, parameters->at(1), parameters->at(2)->integerValue64, parameters->at(3), parameters->at(4)->booleanValue);
+  if (!node_input_) return std::make_shared<Ipc::Variable>();
 
-  return std::make_shared<Ipc::Variable>();
+  bool synchronous = parameters->at(4)->booleanValue;
+  if (!synchronous) {
+    node_input_(pthread_self(), 0, parameters->at(0)->stringValue, parameters->at(1), parameters->at(2)->integerValue64, parameters->at(3), false);
+    return std::make_shared<Ipc::Variable>();
+  }
+
+  //Synchronous inputs are only answered once the node has processed the message.
+  return WaitForLocalResult("nodeInput", [&](pthread_t thread_id, uint64_t request_id) {
+    return node_input_(thread_id, request_id, parameters->at(0)->stringValue, parameters->at(1), parameters->at(2)->integerValue64, parameters->at(3), true);
+  }, std::make_shared<Ipc::Variable>());
 }
 // }}}
\ No newline at end of file
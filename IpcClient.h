@@ -31,16 +31,22 @@
 #ifndef IPCCLIENT_H_
 #define IPCCLIENT_H_
 
+#include "EventLog.h"
 #include <homegear-ipc/IIpcClient.h>
 
 #include <thread>
 #include <mutex>
 #include <string>
 #include <set>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
 
 class IpcClient : public Ipc::IIpcClient {
  public:
   struct InvokeResultInfo {
+    uint64_t request_id = 0;
     std::atomic_bool finished{false};
     Ipc::PVariable result;
   };
@@ -49,7 +55,23 @@ class IpcClient : public Ipc::IIpcClient {
   explicit IpcClient(const std::string &socketPath);
   ~IpcClient() override;
 
-  void InvokeResult(pthread_t thread_id, const Ipc::PVariable &result);
+  /**
+   * Passes the result of a local request to the waiting IPC thread. The result is dropped when request_id doesn't match
+   * the request the thread is waiting for, e.g. because the request timed out and the thread moved on.
+   */
+  void InvokeResult(pthread_t thread_id, uint64_t request_id, const Ipc::PVariable &result);
+
+  /**
+   * Binds all IPC threads to the given CPUs. The threads are created by Ipc::IIpcClient, so each thread applies the
+   * affinity itself the first time it calls into this class. Must be called before start().
+   */
+  void SetCpuAffinity(const std::vector<int32_t> &cpus);
+
+  /**
+   * Runs the thread reporting the connection (the socket reader) with SCHED_FIFO and the given priority. 0 keeps the
+   * default scheduling. Must be called before start().
+   */
+  void SetReaderPriority(int32_t priority) { reader_priority_ = priority; }
 
   void SetOnConnect(std::function<void(void)> value) { on_connect_.swap(value); }
   void SetOnDisconnect(std::function<void(void)> value) { on_disconnect_.swap(value); }
@@ -57,10 +79,34 @@ class IpcClient : public Ipc::IIpcClient {
   void RemoveOnDisconnect() { on_disconnect_ = std::function<void(void)>(); }
   void SetBroadcastEvent(std::function<void(std::string &event_source, uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value)> value) { broadcast_event_.swap(value); }
   void RemoveBroadcastEvent() { broadcast_event_ = std::function<void(std::string &event_source, uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value)>(); }
-  void SetNodeInput(std::function<void(const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous)> value) { node_input_.swap(value); }
-  void RemoveNodeInput() { node_input_ = std::function<void(const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable message, bool synchronous)>(); }
-  void SetInvokeNodeMethod(std::function<bool(pthread_t thread_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters)> value) { invoke_node_method_.swap(value); }
-  void RemoveInvokeNodeMethod() { invoke_node_method_ = std::function<bool(pthread_t thread_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters)>(); }
+  /**
+   * The callback returns true when the result is passed to InvokeResult() later. This is only waited for when the input
+   * is synchronous. request_id is 0 for asynchronous inputs.
+   */
+  void SetNodeInput(std::function<bool(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous)> value) { node_input_.swap(value); }
+  void RemoveNodeInput() { node_input_ = std::function<bool(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous)>(); }
+  void SetDevicesChanged(std::function<void(void)> value) { devices_changed_.swap(value); }
+  void RemoveDevicesChanged() { devices_changed_ = std::function<void(void)>(); }
+  void SetInvokeNodeMethod(std::function<bool(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters)> value) { invoke_node_method_.swap(value); }
+  void RemoveInvokeNodeMethod() { invoke_node_method_ = std::function<bool(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters)>(); }
+  /**
+   * Called on the IPC thread when it stopped waiting for the result of a node method call, also when the wait timed out.
+   */
+  void SetInvokeNodeMethodFinished(std::function<void(pthread_t thread_id)> value) { invoke_node_method_finished_.swap(value); }
+  void RemoveInvokeNodeMethodFinished() { invoke_node_method_finished_ = std::function<void(pthread_t thread_id)>(); }
+
+  /**
+   * Appends all received events and node inputs to recorder. Pass nullptr to stop recording.
+   *
+   * @return Returns the previous recorder.
+   */
+  std::shared_ptr<EventLogWriter> SetRecorder(const std::shared_ptr<EventLogWriter> &recorder);
+
+  /**
+   * Passes a recorded packet to the same callbacks as a packet received from Homegear. Synchronous node inputs are
+   * replayed as asynchronous ones as there is no Homegear to answer.
+   */
+  void Replay(const std::string &method_name, Ipc::PArray &parameters);
  private:
   struct LocalRequestInfo {
     std::mutex wait_mutex;
@@ -70,26 +116,55 @@ class IpcClient : public Ipc::IIpcClient {
 
   std::function<void(void)> on_connect_;
   std::function<void(void)> on_disconnect_;
+  std::function<void(void)> devices_changed_;
   std::function<void(std::string &event_source, uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value)> broadcast_event_;
-  std::function<void(const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous)> node_input_;
-  std::function<bool(pthread_t thread_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters)> invoke_node_method_;
+  std::function<bool(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const Ipc::PVariable &node_info, uint32_t input_index, const Ipc::PVariable &message, bool synchronous)> node_input_;
+  std::function<bool(pthread_t thread_id, uint64_t request_id, const std::string &node_id, const std::string &method_name, const Ipc::PVariable &parameters)> invoke_node_method_;
+  std::function<void(pthread_t thread_id)> invoke_node_method_finished_;
+
+  bool has_cpu_affinity_ = false;
+  cpu_set_t cpu_affinity_;
+  int32_t reader_priority_ = 0;
+
+  std::atomic_bool recording_{false};
+  std::mutex recorder_mutex_;
+  std::shared_ptr<EventLogWriter> recorder_;
 
   std::mutex local_request_info_mutex_;
   std::unordered_map<pthread_t, PLocalRequestInfo> local_request_Info_;
   std::mutex invoke_results_mutex_;
-  // We only have one method call per time per thread so we don't need a packet ID.
+  // There is only one method call per time per thread. The request ID identifies results arriving after the wait ended.
   std::unordered_map<pthread_t, PInvokeResultInfo> invoke_results_;
+  std::atomic<uint64_t> next_request_id_{1};
+
+  /**
+   * Calls dispatch and waits until InvokeResult() is called for this thread. When dispatch returns false, not_dispatched_result is returned.
+   */
+  Ipc::PVariable WaitForLocalResult(const std::string &method_name, const std::function<bool(pthread_t thread_id, uint64_t request_id)> &dispatch, const Ipc::PVariable &not_dispatched_result);
+
+  /**
+   * Applies the CPU affinity to the calling IPC thread on its first call.
+   */
+  void ConfigureThread();
+
+  void Record(const std::string &method_name, Ipc::PArray &parameters);
 
   void onConnect() override;
   void onDisconnect() override;
 
   // {{{ RPC methods
   Ipc::PVariable broadcastEvent(Ipc::PArray &parameters) override;
+  Ipc::PVariable DispatchEvent(Ipc::PArray &parameters);
+  Ipc::PVariable broadcastNewDevices(Ipc::PArray &parameters) override;
+  Ipc::PVariable broadcastDeleteDevices(Ipc::PArray &parameters) override;
+  Ipc::PVariable broadcastUpdateDevice(Ipc::PArray &parameters) override;
+  Ipc::PVariable BroadcastDevicesChanged();
   // }}}
 
   // {{{ RPC methods when used in a Node-BLUE node
   Ipc::PVariable InvokeNodeMethod(Ipc::PArray &parameters);
   Ipc::PVariable NodeInput(Ipc::PArray &parameters);
+  Ipc::PVariable DispatchNodeInput(Ipc::PArray &parameters);
   // }}}
 };
 
@@ -30,6 +30,7 @@
 
 #include "NapiVariableConverter.h"
 #include <cassert>
+#include <cmath>
 
 Ipc::PVariable NapiVariableConverter::getVariable(napi_env env, napi_value value) {
   Ipc::PVariable variable;
@@ -45,24 +46,18 @@ Ipc::PVariable NapiVariableConverter::getVariable(napi_env env, napi_value value
     assert(status == napi_ok);
     return std::make_shared<Ipc::Variable>(boolean_value);
   } else if (valuetype == napi_number) {
-    int64_t integer_value;
+    //All JavaScript numbers are doubles. Integral values in the range of int64_t are passed as integers.
     double double_value;
-    status = napi_get_value_int64(env, value, &integer_value);
-    assert(status == napi_ok);
     status = napi_get_value_double(env, value, &double_value);
     assert(status == napi_ok);
-    if (double_value != (double)integer_value) return std::make_shared<Ipc::Variable>(double_value);
-    else return std::make_shared<Ipc::Variable>(integer_value);
+    if (std::trunc(double_value) == double_value && double_value >= -9223372036854775808.0 && double_value < 9223372036854775808.0) {
+      return std::make_shared<Ipc::Variable>((int64_t)double_value);
+    }
+    return std::make_shared<Ipc::Variable>(double_value);
   } else if (valuetype == napi_string) {
-    size_t string_length = 0;
-    status = napi_get_value_string_utf8(env, value, nullptr, 0, &string_length);
-    assert(status == napi_ok);
-    std::string string_value;
-    string_value.resize(string_length + 1);
-    status = napi_get_value_string_utf8(env, value, (char *)string_value.data(), string_value.size(), &string_length);
-    assert(status == napi_ok);
-    string_value.resize(string_length);
-    return std::make_shared<Ipc::Variable>(string_value);
+    auto string_variable = std::make_shared<Ipc::Variable>(Ipc::VariableType::tString);
+    getString(env, value, string_variable->stringValue);
+    return string_variable;
   } else if (valuetype == napi_symbol) {
     //All non-String values that may be used as the key of on Object property.
   } else if (valuetype == napi_object) {
@@ -85,23 +80,22 @@ Ipc::PVariable NapiVariableConverter::getVariable(napi_env env, napi_value value
     } else {
       auto ipc_struct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
       napi_value properties;
-      status = napi_get_property_names(env, value, &properties);
+      //Only own properties are returned, so there is no need to call napi_has_own_property() for every key.
+      status = napi_get_all_property_names(env, value, napi_key_own_only, (napi_key_filter)(napi_key_enumerable | napi_key_skip_symbols), napi_key_numbers_to_strings, &properties);
       assert(status == napi_ok);
       uint32_t array_length;
       status = napi_get_array_length(env, properties, &array_length);
       assert(status == napi_ok);
+      std::string key;
       for (uint32_t i = 0; i < array_length; i++) {
         napi_value property_name;
         status = napi_get_element(env, properties, i, &property_name);
         assert(status == napi_ok);
         napi_value element_value;
-        bool has_own_property = false;
-        status = napi_has_own_property(env, value, property_name, &has_own_property);
-        assert(status == napi_ok);
-        if (!has_own_property) continue;
         status = napi_get_property(env, value, property_name, &element_value);
         assert(status == napi_ok);
-        ipc_struct->structValue->emplace(getVariable(env, property_name)->stringValue, getVariable(env, element_value));
+        getString(env, property_name, key);
+        ipc_struct->structValue->emplace(key, getVariable(env, element_value));
       }
       if (ipc_struct->structValue->find("faultCode") != ipc_struct->structValue->end()) ipc_struct->errorStruct = true;
       return ipc_struct;
@@ -120,38 +114,151 @@ Ipc::PVariable NapiVariableConverter::getVariable(napi_env env, napi_value value
   return std::make_shared<Ipc::Variable>();
 }
 
+void NapiVariableConverter::getString(napi_env env, napi_value value, std::string &result) {
+  //Most strings fit into the buffer, so they are copied with one call instead of querying the length first.
+  thread_local std::vector<char> buffer(1024);
+  size_t string_length = 0;
+  auto status = napi_get_value_string_utf8(env, value, buffer.data(), buffer.size(), &string_length);
+  assert(status == napi_ok);
+  //A UTF-8 character is never split, so a truncated string can be up to 4 bytes shorter than the buffer.
+  if (string_length + 4 >= buffer.size()) {
+    status = napi_get_value_string_utf8(env, value, nullptr, 0, &string_length);
+    assert(status == napi_ok);
+    buffer.resize(string_length + 1);
+    status = napi_get_value_string_utf8(env, value, buffer.data(), buffer.size(), &string_length);
+    assert(status == napi_ok);
+  }
+  result.assign(buffer.data(), string_length);
+}
+
 napi_value NapiVariableConverter::getNapiVariable(napi_env env, const Ipc::PVariable &value) {
   if (!value) return nullptr;
-  napi_value result = nullptr;
-  if (value->type == Ipc::VariableType::tVoid) {
-    auto status = napi_get_null(env, &result);
+  Conversion conversion(value, Limits());
+  conversion.Continue(env, std::chrono::microseconds(0));
+  return conversion.Result();
+}
+
+NapiVariableConverter::Conversion::Conversion(Ipc::PVariable value, const Limits &limits) : root_(std::move(value)), limits_(limits) {
+}
+
+bool NapiVariableConverter::Conversion::Continue(napi_env env, std::chrono::microseconds time_budget) {
+  if (!error_.empty()) return true;
+  if (!started_) {
+    started_ = true;
+    if (!root_) return true;
+    if (!CreateValue(env, root_.get(), 1, result_)) return true;
+  } else if (result_reference_) { //Resume
+    auto status = napi_get_reference_value(env, result_reference_, &result_);
     assert(status == napi_ok);
+    for (auto &frame : stack_) {
+      status = napi_get_reference_value(env, frame.target_reference, &frame.target);
+      assert(status == napi_ok);
+    }
+    Release(env);
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+  uint32_t counter = 0;
+  while (!stack_.empty()) {
+    //Reading the clock for every value would be too expensive.
+    if (time_budget.count() > 0 && (++counter & 0xFF) == 0 && std::chrono::steady_clock::now() - start_time >= time_budget) return false;
+
+    //CreateValue() might push to the stack, so no reference to the frame is kept.
+    auto &frame = stack_.back();
+    auto target = frame.target;
+    auto depth = frame.depth;
+    napi_value child;
+    if (frame.source->type == Ipc::VariableType::tArray) {
+      if (frame.array_index >= frame.source->arrayValue->size()) {
+        stack_.pop_back();
+        continue;
+      }
+      auto index = (uint32_t)frame.array_index++;
+      if (!CreateValue(env, frame.source->arrayValue->at(index).get(), depth + 1, child)) return true;
+      auto status = napi_set_element(env, target, index, child);
+      assert(status == napi_ok);
+    } else {
+      if (frame.struct_iterator == frame.source->structValue->end()) {
+        stack_.pop_back();
+        continue;
+      }
+      auto &element = *(frame.struct_iterator++);
+      if (!CreateValue(env, element.second.get(), depth + 1, child)) return true;
+      auto status = napi_set_named_property(env, target, element.first.c_str(), child);
+      assert(status == napi_ok);
+    }
+  }
+
+  return true;
+}
+
+bool NapiVariableConverter::Conversion::CreateValue(napi_env env, const Ipc::Variable *value, uint32_t depth, napi_value &result) {
+  result = nullptr;
+  if (limits_.max_size != 0 && ++size_ > limits_.max_size) {
+    error_ = "Value exceeds the maximum size of " + std::to_string(limits_.max_size) + " elements.";
+    stack_.clear();
+    return false;
+  }
+  if (limits_.max_depth != 0 && depth > limits_.max_depth) {
+    error_ = "Value exceeds the maximum depth of " + std::to_string(limits_.max_depth) + ".";
+    stack_.clear();
+    return false;
+  }
+
+  napi_status status;
+  if (!value || value->type == Ipc::VariableType::tVoid) {
+    status = napi_get_null(env, &result);
   } else if (value->type == Ipc::VariableType::tBoolean) {
-    auto status = napi_get_boolean(env, value->booleanValue, &result);
-    assert(status == napi_ok);
+    status = napi_get_boolean(env, value->booleanValue, &result);
   } else if (value->type == Ipc::VariableType::tInteger || value->type == Ipc::VariableType::tInteger64) {
-    auto status = napi_create_int64(env, value->integerValue64, &result);
-    assert(status == napi_ok);
+    status = napi_create_int64(env, value->integerValue64, &result);
   } else if (value->type == Ipc::VariableType::tFloat) {
-    auto status = napi_create_double(env, value->floatValue, &result);
-    assert(status == napi_ok);
+    status = napi_create_double(env, value->floatValue, &result);
   } else if (value->type == Ipc::VariableType::tString || value->type == Ipc::VariableType::tBase64) {
-    auto status = napi_create_string_utf8(env, value->stringValue.c_str(), NAPI_AUTO_LENGTH, &result);
-    assert(status == napi_ok);
+    status = napi_create_string_utf8(env, value->stringValue.c_str(), value->stringValue.size(), &result);
   } else if (value->type == Ipc::VariableType::tArray) {
-    auto status = napi_create_array_with_length(env, value->arrayValue->size(), &result);
-    assert(status == napi_ok);
-    for (uint32_t i = 0; i < value->arrayValue->size(); i++) {
-      status = napi_set_element(env, result, i, getNapiVariable(env, value->arrayValue->at(i)));
-      assert(status == napi_ok);
+    status = napi_create_array_with_length(env, value->arrayValue->size(), &result);
+    if (!value->arrayValue->empty()) {
+      Frame frame;
+      frame.source = value;
+      frame.target = result;
+      frame.depth = depth;
+      stack_.push_back(frame);
     }
   } else if (value->type == Ipc::VariableType::tStruct) {
-    auto status = napi_create_object(env, &result);
-    assert(status == napi_ok);
-    for (auto &element : *value->structValue) {
-      status = napi_set_named_property(env, result, element.first.c_str(), getNapiVariable(env, element.second));
-      assert(status == napi_ok);
+    status = napi_create_object(env, &result);
+    if (!value->structValue->empty()) {
+      Frame frame;
+      frame.source = value;
+      frame.target = result;
+      frame.depth = depth;
+      frame.struct_iterator = value->structValue->begin();
+      stack_.push_back(frame);
     }
+  } else {
+    //Types without a JavaScript representation.
+    status = napi_get_null(env, &result);
+  }
+  assert(status == napi_ok);
+  return true;
+}
+
+void NapiVariableConverter::Conversion::Suspend(napi_env env) {
+  auto status = napi_create_reference(env, result_, 1, &result_reference_);
+  assert(status == napi_ok);
+  for (auto &frame : stack_) {
+    status = napi_create_reference(env, frame.target, 1, &frame.target_reference);
+    assert(status == napi_ok);
+    frame.target = nullptr;
+  }
+  result_ = nullptr;
+}
+
+void NapiVariableConverter::Conversion::Release(napi_env env) {
+  if (result_reference_) napi_delete_reference(env, result_reference_);
+  result_reference_ = nullptr;
+  for (auto &frame : stack_) {
+    if (frame.target_reference) napi_delete_reference(env, frame.target_reference);
+    frame.target_reference = nullptr;
   }
-  return result;
 }
@@ -34,10 +34,82 @@
 #include <homegear-ipc/Variable.h>
 #include <node_api.h>
 
+#include <chrono>
+#include <string>
+#include <vector>
+
 class NapiVariableConverter {
  public:
+  struct Limits {
+    /**
+     * The maximum nesting depth. 0 means no limit.
+     */
+    uint32_t max_depth = 0;
+
+    /**
+     * The maximum number of values (including arrays and structs). 0 means no limit.
+     */
+    size_t max_size = 0;
+  };
+
+  /**
+   * Converts an Ipc::Variable into a JavaScript value using an explicit work stack instead of recursion. The conversion
+   * can be paused when a time budget is used up and continued in a later call on the JavaScript thread.
+   */
+  class Conversion {
+   public:
+    Conversion(Ipc::PVariable value, const Limits &limits);
+
+    /**
+     * Converts until the conversion is finished or time_budget is used up. A time budget of 0 means no limit.
+     *
+     * @return Returns true when the conversion is finished or failed. When false is returned, Suspend() needs to be
+     * called before returning to JavaScript.
+     */
+    bool Continue(napi_env env, std::chrono::microseconds time_budget);
+
+    /**
+     * Keeps the partially converted result alive until the next call to Continue().
+     */
+    void Suspend(napi_env env);
+
+    /**
+     * Deletes all references. Needs to be called when a suspended conversion is not continued.
+     */
+    void Release(napi_env env);
+
+    napi_value Result() const { return result_; }
+    const std::string &Error() const { return error_; }
+   private:
+    struct Frame {
+      const Ipc::Variable *source = nullptr;
+      napi_value target = nullptr;
+      napi_ref target_reference = nullptr;
+      uint32_t depth = 0;
+      size_t array_index = 0;
+      Ipc::Struct::const_iterator struct_iterator;
+    };
+
+    Ipc::PVariable root_;
+    Limits limits_;
+    bool started_ = false;
+    napi_value result_ = nullptr;
+    napi_ref result_reference_ = nullptr;
+    std::vector<Frame> stack_;
+    size_t size_ = 0;
+    std::string error_;
+
+    bool CreateValue(napi_env env, const Ipc::Variable *value, uint32_t depth, napi_value &result);
+  };
+
   static Ipc::PVariable getVariable(napi_env env, napi_value value);
   static napi_value getNapiVariable(napi_env env, const Ipc::PVariable &value);
+
+ private:
+  /**
+   * Copies a JavaScript string into result using a reusable per-thread buffer.
+   */
+  static void getString(napi_env env, napi_value value, std::string &result);
 };
 
 #endif //HOMEGEAR_NODEJS__NAPIVARIABLECONVERTER_H_
@@ -0,0 +1,128 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "ResultCache.h"
+#include <functional>
+
+Ipc::PVariable ResultCache::Get(const std::string &method, const Ipc::PArray &parameters) {
+  auto hash = Hash(method, parameters);
+  std::lock_guard<std::mutex> entries_guard(entries_mutex_);
+  auto range = entries_.equal_range(hash);
+  for (auto entry_iterator = range.first; entry_iterator != range.second; ++entry_iterator) {
+    auto &entry = entry_iterator->second;
+    if (entry.method != method || !Equal(entry.parameters, parameters)) continue;
+    hits_++;
+    return entry.result;
+  }
+
+  misses_++;
+  return Ipc::PVariable();
+}
+
+void ResultCache::Set(const std::string &method, const Ipc::PArray &parameters, const Ipc::PVariable &result, uint64_t generation) {
+  if (!result || result->errorStruct) return;
+  auto hash = Hash(method, parameters);
+  std::lock_guard<std::mutex> entries_guard(entries_mutex_);
+  if (generation != generation_ || entries_.size() >= max_entries_) return;
+
+  Entry entry;
+  entry.method = method;
+  entry.parameters = parameters;
+  entry.result = result;
+  entries_.emplace(hash, std::move(entry));
+}
+
+void ResultCache::Invalidate() {
+  std::lock_guard<std::mutex> entries_guard(entries_mutex_);
+  generation_++;
+  invalidations_++;
+  entries_.clear();
+}
+
+void ResultCache::Clear() {
+  std::lock_guard<std::mutex> entries_guard(entries_mutex_);
+  entries_.clear();
+}
+
+Ipc::PVariable ResultCache::GetStats() {
+  auto stats = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+  {
+    std::lock_guard<std::mutex> entries_guard(entries_mutex_);
+    stats->structValue->emplace("entries", std::make_shared<Ipc::Variable>((int64_t)entries_.size()));
+  }
+  stats->structValue->emplace("hits", std::make_shared<Ipc::Variable>((int64_t)hits_));
+  stats->structValue->emplace("misses", std::make_shared<Ipc::Variable>((int64_t)misses_));
+  stats->structValue->emplace("invalidations", std::make_shared<Ipc::Variable>((int64_t)invalidations_));
+  return stats;
+}
+
+size_t ResultCache::Hash(const std::string &method, const Ipc::PArray &parameters) {
+  size_t seed = std::hash<std::string>()(method);
+  for (auto &parameter : *parameters) {
+    seed = Hash(parameter, seed);
+  }
+  return seed;
+}
+
+size_t ResultCache::Hash(const Ipc::PVariable &value, size_t seed) {
+  auto combine = [&seed](size_t hash) {
+    seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  };
+
+  if (!value) return seed;
+  combine((size_t)value->type);
+  if (value->type == Ipc::VariableType::tBoolean) {
+    combine(value->booleanValue);
+  } else if (value->type == Ipc::VariableType::tInteger || value->type == Ipc::VariableType::tInteger64) {
+    combine(std::hash<int64_t>()(value->integerValue64));
+  } else if (value->type == Ipc::VariableType::tFloat) {
+    combine(std::hash<double>()(value->floatValue));
+  } else if (value->type == Ipc::VariableType::tString || value->type == Ipc::VariableType::tBase64) {
+    combine(std::hash<std::string>()(value->stringValue));
+  } else if (value->type == Ipc::VariableType::tArray) {
+    for (auto &element : *value->arrayValue) {
+      seed = Hash(element, seed);
+    }
+  } else if (value->type == Ipc::VariableType::tStruct) {
+    for (auto &element : *value->structValue) {
+      combine(std::hash<std::string>()(element.first));
+      seed = Hash(element.second, seed);
+    }
+  }
+  return seed;
+}
+
+bool ResultCache::Equal(const Ipc::PArray &parameters1, const Ipc::PArray &parameters2) {
+  if (parameters1->size() != parameters2->size()) return false;
+  for (size_t i = 0; i < parameters1->size(); i++) {
+    if (!(*parameters1->at(i) == *parameters2->at(i))) return false;
+  }
+  return true;
+}
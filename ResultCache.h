@@ -0,0 +1,90 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__RESULTCACHE_H_
+#define HOMEGEAR_NODEJS__RESULTCACHE_H_
+
+#include <homegear-ipc/Variable.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * Caches the results of idempotent RPC methods. The native results are stored, so every hit is converted to a new
+ * JavaScript value and callers can't corrupt the results of later calls by modifying them. All methods can be called
+ * from any thread, so invoke() and the worker threads of invokeAsync() share the cache.
+ */
+class ResultCache {
+ public:
+  void SetMethods(const std::unordered_set<std::string> &methods) { methods_ = methods; }
+  void SetMaxEntries(size_t max_entries) { max_entries_ = max_entries; }
+  bool IsCacheable(const std::string &method) const { return methods_.find(method) != methods_.end(); }
+  uint64_t Generation() const { return generation_; }
+
+  /**
+   * Returns the cached result or nullptr.
+   */
+  Ipc::PVariable Get(const std::string &method, const Ipc::PArray &parameters);
+
+  /**
+   * Stores the result unless the cache was invalidated after generation was read (i. e. while the RPC was running).
+   * Errors are not stored.
+   */
+  void Set(const std::string &method, const Ipc::PArray &parameters, const Ipc::PVariable &result, uint64_t generation);
+  void Invalidate();
+  void Clear();
+
+  Ipc::PVariable GetStats();
+ private:
+  struct Entry {
+    std::string method;
+    Ipc::PArray parameters;
+    Ipc::PVariable result;
+  };
+
+  std::unordered_set<std::string> methods_;
+  size_t max_entries_ = 1000;
+  std::mutex entries_mutex_;
+  std::atomic<uint64_t> generation_{0};
+  std::unordered_multimap<size_t, Entry> entries_;
+
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> invalidations_{0};
+
+  static size_t Hash(const std::string &method, const Ipc::PArray &parameters);
+  static size_t Hash(const Ipc::PVariable &value, size_t seed);
+  static bool Equal(const Ipc::PArray &parameters1, const Ipc::PArray &parameters2);
+};
+
+#endif //HOMEGEAR_NODEJS__RESULTCACHE_H_
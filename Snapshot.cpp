@@ -0,0 +1,144 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Snapshot.h"
+#include "NapiVariableConverter.h"
+
+#include <cassert>
+#include <cstring>
+
+void Snapshot::Add(uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value) {
+  auto variable_index_iterator = variable_indexes_.find(variable_name);
+  if (variable_index_iterator == variable_indexes_.end()) {
+    variable_index_iterator = variable_indexes_.emplace(variable_name, (uint32_t)variable_names_.size()).first;
+    variable_names_.push_back(variable_name);
+  }
+
+  ValueType type = ValueType::kOther;
+  double numeric_value = 0;
+  if (!value || value->type == Ipc::VariableType::tVoid) type = ValueType::kVoid;
+  else if (value->type == Ipc::VariableType::tBoolean) {
+    type = ValueType::kBoolean;
+    numeric_value = value->booleanValue ? 1 : 0;
+  } else if (value->type == Ipc::VariableType::tInteger || value->type == Ipc::VariableType::tInteger64) {
+    type = ValueType::kInteger;
+    numeric_value = (double)value->integerValue64;
+  } else if (value->type == Ipc::VariableType::tFloat) {
+    type = ValueType::kFloat;
+    numeric_value = value->floatValue;
+  } else {
+    //Everything else is referenced by its index in the side table.
+    if (value->type == Ipc::VariableType::tString) type = ValueType::kString;
+    else if (value->type == Ipc::VariableType::tArray) type = ValueType::kArray;
+    else if (value->type == Ipc::VariableType::tStruct) type = ValueType::kStruct;
+    numeric_value = (double)complex_values_.size();
+    complex_values_.push_back(value);
+  }
+
+  peer_ids_.push_back(peer_id);
+  channels_.push_back(channel);
+  variables_.push_back(variable_index_iterator->second);
+  types_.push_back((uint8_t)type);
+  values_.push_back(numeric_value);
+}
+
+napi_value Snapshot::CreateTypedArray(napi_env env, napi_typedarray_type type, size_t length, napi_value buffer, size_t offset) {
+  napi_value typed_array;
+  auto status = napi_create_typedarray(env, type, length, buffer, offset, &typed_array);
+  assert(status == napi_ok);
+  return typed_array;
+}
+
+napi_value Snapshot::ToNapi(napi_env env) {
+  auto count = peer_ids_.size();
+
+  //Columns with larger elements first, so every typed array is aligned to its element size.
+  size_t peer_ids_offset = 0;
+  size_t values_offset = peer_ids_offset + count * sizeof(uint64_t);
+  size_t channels_offset = values_offset + count * sizeof(double);
+  size_t variables_offset = channels_offset + count * sizeof(int32_t);
+  size_t types_offset = variables_offset + count * sizeof(uint32_t);
+  size_t buffer_size = types_offset + count * sizeof(uint8_t);
+
+  napi_value buffer;
+  void *data = nullptr;
+  auto status = napi_create_arraybuffer(env, buffer_size, &data, &buffer);
+  assert(status == napi_ok);
+  if (count > 0) {
+    memcpy((char *)data + peer_ids_offset, peer_ids_.data(), count * sizeof(uint64_t));
+    memcpy((char *)data + values_offset, values_.data(), count * sizeof(double));
+    memcpy((char *)data + channels_offset, channels_.data(), count * sizeof(int32_t));
+    memcpy((char *)data + variables_offset, variables_.data(), count * sizeof(uint32_t));
+    memcpy((char *)data + types_offset, types_.data(), count * sizeof(uint8_t));
+  }
+
+  napi_value result;
+  status = napi_create_object(env, &result);
+  assert(status == napi_ok);
+
+  napi_value count_value;
+  status = napi_create_uint32(env, (uint32_t)count, &count_value);
+  assert(status == napi_ok);
+
+  napi_value variable_names;
+  status = napi_create_array_with_length(env, variable_names_.size(), &variable_names);
+  assert(status == napi_ok);
+  for (uint32_t i = 0; i < variable_names_.size(); i++) {
+    napi_value variable_name;
+    status = napi_create_string_utf8(env, variable_names_[i].c_str(), variable_names_[i].size(), &variable_name);
+    assert(status == napi_ok);
+    status = napi_set_element(env, variable_names, i, variable_name);
+    assert(status == napi_ok);
+  }
+
+  napi_value complex_values;
+  status = napi_create_array_with_length(env, complex_values_.size(), &complex_values);
+  assert(status == napi_ok);
+  for (uint32_t i = 0; i < complex_values_.size(); i++) {
+    status = napi_set_element(env, complex_values, i, NapiVariableConverter::getNapiVariable(env, complex_values_[i]));
+    assert(status == napi_ok);
+  }
+
+  napi_property_descriptor properties[] = {
+      {"count", nullptr, nullptr, nullptr, nullptr, count_value, napi_enumerable, nullptr},
+      {"buffer", nullptr, nullptr, nullptr, nullptr, buffer, napi_enumerable, nullptr},
+      {"peerIds", nullptr, nullptr, nullptr, nullptr, CreateTypedArray(env, napi_biguint64_array, count, buffer, peer_ids_offset), napi_enumerable, nullptr},
+      {"channels", nullptr, nullptr, nullptr, nullptr, CreateTypedArray(env, napi_int32_array, count, buffer, channels_offset), napi_enumerable, nullptr},
+      {"variables", nullptr, nullptr, nullptr, nullptr, CreateTypedArray(env, napi_uint32_array, count, buffer, variables_offset), napi_enumerable, nullptr},
+      {"types", nullptr, nullptr, nullptr, nullptr, CreateTypedArray(env, napi_uint8_array, count, buffer, types_offset), napi_enumerable, nullptr},
+      {"values", nullptr, nullptr, nullptr, nullptr, CreateTypedArray(env, napi_float64_array, count, buffer, values_offset), napi_enumerable, nullptr},
+      {"variableNames", nullptr, nullptr, nullptr, nullptr, variable_names, napi_enumerable, nullptr},
+      {"complexValues", nullptr, nullptr, nullptr, nullptr, complex_values, napi_enumerable, nullptr},
+  };
+  status = napi_define_properties(env, result, sizeof(properties) / sizeof(properties[0]), properties);
+  assert(status == napi_ok);
+
+  return result;
+}
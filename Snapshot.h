@@ -0,0 +1,81 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__SNAPSHOT_H_
+#define HOMEGEAR_NODEJS__SNAPSHOT_H_
+
+#include <homegear-ipc/Variable.h>
+#include <node_api.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Values of many variables in columns instead of one object per variable. Peer IDs are stored in a BigUint64Array, so
+ * they keep their full 64 bits. Numeric and boolean values are stored in a Float64Array, all other values in a side table referenced by index. All typed arrays share one ArrayBuffer, so
+ * the snapshot costs a handful of JavaScript objects independent of the number of variables. Add() may be called from
+ * a worker thread, ToNapi() only from the JavaScript thread.
+ */
+class Snapshot {
+ public:
+  enum class ValueType : uint8_t {
+    kVoid = 0,
+    kBoolean = 1,
+    kInteger = 2,
+    kFloat = 3,
+    kString = 4,
+    kArray = 5,
+    kStruct = 6,
+    kOther = 7
+  };
+
+  void Add(uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value);
+  size_t Count() const { return peer_ids_.size(); }
+
+  /**
+   * Returns { count, buffer, peerIds, channels, variables, types, values, variableNames, complexValues }.
+   */
+  napi_value ToNapi(napi_env env);
+ private:
+  std::vector<uint64_t> peer_ids_;
+  std::vector<double> values_;
+  std::vector<int32_t> channels_;
+  std::vector<uint32_t> variables_;
+  std::vector<uint8_t> types_;
+  std::unordered_map<std::string, uint32_t> variable_indexes_;
+  std::vector<std::string> variable_names_;
+  std::vector<Ipc::PVariable> complex_values_;
+
+  static napi_value CreateTypedArray(napi_env env, napi_typedarray_type type, size_t length, napi_value buffer, size_t offset);
+};
+
+#endif //HOMEGEAR_NODEJS__SNAPSHOT_H_
@@ -0,0 +1,111 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef HOMEGEAR_NODEJS_USDT
+//The semaphore lets Enabled() find out whether a tracer is attached to the probe.
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+extern "C" {
+volatile unsigned short homegear_nodejs_span_semaphore __attribute__((section(".probes"))) = 0;
+}
+#endif
+
+namespace {
+int32_t CurrentThreadId() {
+  thread_local int32_t thread_id = (int32_t)syscall(SYS_gettid);
+  return thread_id;
+}
+}
+
+int64_t Tracer::Now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::Start(size_t capacity) {
+  std::lock_guard<std::mutex> spans_guard(spans_mutex_);
+  spans_.clear();
+  spans_.shrink_to_fit();
+  spans_.resize(capacity);
+  span_count_ = 0;
+  buffered_ = capacity > 0;
+  enabled_ = true;
+}
+
+std::string Tracer::Stop() {
+  enabled_ = false;
+  buffered_ = false;
+
+  std::lock_guard<std::mutex> spans_guard(spans_mutex_);
+  std::string json;
+  json.reserve(128 + std::min<uint64_t>(span_count_, spans_.size()) * 96);
+  json.append(R"({"displayTimeUnit":"ms","traceEvents":[)");
+  auto pid = std::to_string(getpid());
+  //When the buffer overflowed, the oldest span is the one at the next write position.
+  uint64_t first = span_count_ > spans_.size() ? span_count_ - spans_.size() : 0;
+  for (uint64_t i = first; i < span_count_; i++) {
+    auto &span = spans_[i % spans_.size()];
+    if (i != first) json.push_back(',');
+    json.append(R"({"ph":"X","cat":")").append(span.category);
+    json.append(R"(","name":")").append(span.name);
+    json.append(R"(","ts":)").append(std::to_string(span.start));
+    json.append(R"(,"dur":)").append(std::to_string(span.duration));
+    json.append(R"(,"pid":)").append(pid);
+    json.append(R"(,"tid":)").append(std::to_string(span.thread_id)).push_back('}');
+  }
+  json.append(R"(],"otherData":{"droppedSpans":)").append(std::to_string(first)).append("}}");
+  return json;
+}
+
+void Tracer::Add(const char *category, const char *name, int64_t start, int64_t end) {
+  auto thread_id = CurrentThreadId();
+#ifdef HOMEGEAR_NODEJS_USDT
+  DTRACE_PROBE5(homegear_nodejs, span, category, name, start, end - start, thread_id);
+#endif
+
+  if (!buffered_) return;
+  std::lock_guard<std::mutex> spans_guard(spans_mutex_);
+  if (spans_.empty() || !enabled_) return;
+  auto &span = spans_[span_count_ % spans_.size()];
+  span.category = category;
+  span.name = name;
+  span.start = start;
+  span.duration = end - start;
+  span.thread_id = thread_id;
+  span_count_++;
+}
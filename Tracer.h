@@ -0,0 +1,125 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__TRACER_H_
+#define HOMEGEAR_NODEJS__TRACER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define HOMEGEAR_NODEJS_USDT
+/**
+ * Incremented by tracers like bpftrace while they are attached to the USDT probe homegear_nodejs:span.
+ */
+extern "C" volatile unsigned short homegear_nodejs_span_semaphore;
+#endif
+#endif
+
+/**
+ * Records the duration of the stages an RPC passes through (IPC, conversion, queueing, JavaScript) in a ring buffer
+ * that can be exported as Chrome trace event JSON. When the build has <sys/sdt.h>, every span also fires the USDT probe
+ * homegear_nodejs:span. Spans are measured while tracing is started or a tracer is attached to the probe, independent of
+ * each other. Otherwise a span costs one relaxed atomic load and one load of the probe semaphore.
+ */
+class Tracer {
+ public:
+  /**
+   * Returns the current time of the monotonic clock in microseconds.
+   */
+  static int64_t Now();
+
+  bool Enabled() const {
+#ifdef HOMEGEAR_NODEJS_USDT
+    if (homegear_nodejs_span_semaphore != 0) return true;
+#endif
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Starts tracing and clears the buffer. With a capacity of 0 nothing is recorded, so only an attached probe gets the
+   * spans.
+   */
+  void Start(size_t capacity);
+
+  /**
+   * Stops tracing and returns the recorded spans as Chrome trace event JSON.
+   */
+  std::string Stop();
+
+  /**
+   * category and name must be string literals, as only the pointers are stored.
+   */
+  void Add(const char *category, const char *name, int64_t start, int64_t end);
+ private:
+  struct Span {
+    const char *category = nullptr;
+    const char *name = nullptr;
+    int64_t start = 0;
+    int64_t duration = 0;
+    int32_t thread_id = 0;
+  };
+
+  std::atomic_bool enabled_{false};
+  std::atomic_bool buffered_{false};
+  std::mutex spans_mutex_;
+  std::vector<Span> spans_;
+  uint64_t span_count_ = 0;
+};
+
+/**
+ * Adds a span from construction to destruction (or End()) to tracer, if tracing was enabled on construction.
+ */
+class TraceSpan {
+ public:
+  TraceSpan(Tracer &tracer, const char *category, const char *name) : tracer_(tracer), category_(category), name_(name), start_(tracer.Enabled() ? Tracer::Now() : 0) {}
+  ~TraceSpan() { End(); }
+
+  /**
+   * Ends the span before the destruction.
+   */
+  void End() {
+    if (start_ != 0) tracer_.Add(category_, name_, start_, Tracer::Now());
+    start_ = 0;
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+ private:
+  Tracer &tracer_;
+  const char *category_;
+  const char *name_;
+  int64_t start_;
+};
+
+#endif //HOMEGEAR_NODEJS__TRACER_H_
@@ -0,0 +1,109 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "ValueStore.h"
+#include <homegear-ipc/HelperFunctions.h>
+
+void ValueStore::Set(uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value) {
+  auto time = Ipc::HelperFunctions::getTime();
+  std::lock_guard<std::mutex> values_guard(mutex_);
+  auto &entry = values_[peer_id][channel][variable_name];
+  entry.value = value;
+  entry.time = time;
+}
+
+bool ValueStore::ForEachValue(const Ipc::PVariable &all_values, const ValueCallback &callback) {
+  if (all_values->type != Ipc::VariableType::tArray) return false;
+
+  //getAllValues returns: [{"ID": peerId, "CHANNELS": [{"INDEX": channel, "PARAMSET": {variableName: {"VALUE": value, ...}}}]}]
+  for (auto &device : *all_values->arrayValue) {
+    auto id_iterator = device->structValue->find("ID");
+    auto channels_iterator = device->structValue->find("CHANNELS");
+    if (id_iterator == device->structValue->end() || channels_iterator == device->structValue->end()) continue;
+    auto peer_id = (uint64_t)id_iterator->second->integerValue64;
+
+    for (auto &channel_struct : *channels_iterator->second->arrayValue) {
+      auto index_iterator = channel_struct->structValue->find("INDEX");
+      auto paramset_iterator = channel_struct->structValue->find("PARAMSET");
+      if (index_iterator == channel_struct->structValue->end() || paramset_iterator == channel_struct->structValue->end()) continue;
+      auto channel = (int32_t)index_iterator->second->integerValue64;
+
+      for (auto &variable : *paramset_iterator->second->structValue) {
+        auto value_iterator = variable.second->structValue->find("VALUE");
+        if (value_iterator == variable.second->structValue->end()) continue;
+        callback(peer_id, channel, variable.first, value_iterator->second);
+      }
+    }
+  }
+
+  return true;
+}
+
+bool ValueStore::Update(const Ipc::PVariable &all_values, int64_t start_time, bool report_new_values, const ChangedCallback &changed) {
+  return ForEachValue(all_values, [&](uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value) {
+    {
+      std::lock_guard<std::mutex> values_guard(mutex_);
+      auto &entry = values_[peer_id][channel][variable_name];
+      if (entry.time >= start_time || (entry.value && *entry.value == *value)) return;
+      bool is_new = !entry.value;
+      entry.value = value;
+      entry.time = start_time;
+      if (is_new && !report_new_values) return;
+    }
+
+    //Called without holding the mutex as the callback might block.
+    changed(peer_id, channel, variable_name, value);
+  });
+}
+
+void ValueStore::ForEach(const ValueCallback &callback) {
+  struct Value {
+    uint64_t peer_id;
+    int32_t channel;
+    std::string variable_name;
+    Ipc::PVariable value;
+  };
+
+  std::vector<Value> values;
+  {
+    std::lock_guard<std::mutex> values_guard(mutex_);
+    for (auto &peer : values_) {
+      for (auto &channel : peer.second) {
+        for (auto &variable : channel.second) {
+          values.push_back(Value{peer.first, channel.first, variable.first, variable.second.value});
+        }
+      }
+    }
+  }
+
+  for (auto &value : values) {
+    callback(value.peer_id, value.channel, value.variable_name, value.value);
+  }
+}
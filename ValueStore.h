@@ -0,0 +1,84 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__VALUESTORE_H_
+#define HOMEGEAR_NODEJS__VALUESTORE_H_
+
+#include <homegear-ipc/Variable.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Last known value of every variable, updated from events. Used to find the values that changed while the connection
+ * to Homegear was lost.
+ */
+class ValueStore {
+ public:
+  typedef std::function<void(uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value)> ValueCallback;
+  typedef ValueCallback ChangedCallback;
+
+  /**
+   * Calls callback for every value in a result of getAllValues.
+   *
+   * @return Returns false when all_values has an unexpected format.
+   */
+  static bool ForEachValue(const Ipc::PVariable &all_values, const ValueCallback &callback);
+
+  void Set(uint64_t peer_id, int32_t channel, const std::string &variable_name, const Ipc::PVariable &value);
+
+  /**
+   * Merges the result of getAllValues into the store and calls changed for every value that differs from the stored
+   * one. Values updated by events since start_time are newer than the result and are kept. Values not in the store yet
+   * are only passed to changed when report_new_values is true. Values missing in all_values are kept.
+   *
+   * @return Returns false when all_values has an unexpected format.
+   */
+  bool Update(const Ipc::PVariable &all_values, int64_t start_time, bool report_new_values, const ChangedCallback &changed);
+
+  /**
+   * Calls callback for every stored value. The values are copied while the store is locked and callback is called
+   * afterwards, so events are not held up by callback.
+   */
+  void ForEach(const ValueCallback &callback);
+ private:
+  struct Entry {
+    Ipc::PVariable value;
+    int64_t time = 0;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, std::unordered_map<int32_t, std::unordered_map<std::string, Entry>>> values_;
+};
+
+#endif //HOMEGEAR_NODEJS__VALUESTORE_H_
@@ -0,0 +1,95 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "VariableHandleTable.h"
+
+uint32_t VariableHandleTable::Register(uint64_t peer_id, int32_t channel, const std::string &variable_name) {
+  std::unique_lock<std::shared_mutex> handles_guard(mutex_);
+  auto &channel_handles = handles_[peer_id][channel];
+  auto handle_iterator = channel_handles.find(variable_name);
+  if (handle_iterator != channel_handles.end()) return handle_iterator->second;
+
+  uint32_t handle;
+  if (free_handles_.empty()) {
+    handle = (uint32_t)entries_.size();
+    entries_.emplace_back();
+  } else {
+    handle = free_handles_.back();
+    free_handles_.pop_back();
+  }
+  auto &entry = entries_.at(handle);
+  entry.peer_id = peer_id;
+  entry.channel = channel;
+  entry.variable_name = variable_name;
+  entry.registered = true;
+  entry.generation++;
+  channel_handles.emplace(variable_name, handle);
+  registered_count_++;
+  return handle;
+}
+
+bool VariableHandleTable::Unregister(uint32_t handle) {
+  std::unique_lock<std::shared_mutex> handles_guard(mutex_);
+  if (handle >= entries_.size() || !entries_.at(handle).registered) return false;
+  auto &entry = entries_.at(handle);
+  auto peer_iterator = handles_.find(entry.peer_id);
+  if (peer_iterator != handles_.end()) {
+    auto channel_iterator = peer_iterator->second.find(entry.channel);
+    if (channel_iterator != peer_iterator->second.end()) {
+      channel_iterator->second.erase(entry.variable_name);
+      if (channel_iterator->second.empty()) peer_iterator->second.erase(channel_iterator);
+    }
+    if (peer_iterator->second.empty()) handles_.erase(peer_iterator);
+  }
+  entry.registered = false;
+  entry.variable_name.clear();
+  entry.variable_name.shrink_to_fit();
+  free_handles_.push_back(handle);
+  registered_count_--;
+  return true;
+}
+
+int64_t VariableHandleTable::Find(uint64_t peer_id, int32_t channel, const std::string &variable_name, uint32_t &generation) {
+  if (registered_count_ == 0) return -1;
+  std::shared_lock<std::shared_mutex> handles_guard(mutex_);
+  auto peer_iterator = handles_.find(peer_id);
+  if (peer_iterator == handles_.end()) return -1;
+  auto channel_iterator = peer_iterator->second.find(channel);
+  if (channel_iterator == peer_iterator->second.end()) return -1;
+  auto handle_iterator = channel_iterator->second.find(variable_name);
+  if (handle_iterator == channel_iterator->second.end()) return -1;
+  generation = entries_.at(handle_iterator->second).generation;
+  return handle_iterator->second;
+}
+
+bool VariableHandleTable::IsCurrent(uint32_t handle, uint32_t generation) {
+  std::shared_lock<std::shared_mutex> handles_guard(mutex_);
+  return handle < entries_.size() && entries_.at(handle).registered && entries_.at(handle).generation == generation;
+}
@@ -0,0 +1,81 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__VARIABLEHANDLETABLE_H_
+#define HOMEGEAR_NODEJS__VARIABLEHANDLETABLE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Maps (peer ID, channel, variable name) to small, dense integer handles. Handles of unregistered variables are reused,
+ * so each handle carries a generation. An event that is still queued when its variable is unregistered is dropped by
+ * checking IsCurrent() instead of being delivered to the variable that got the handle next.
+ */
+class VariableHandleTable {
+ public:
+  /**
+   * Returns the handle of the variable. Registering the same variable twice returns the same handle.
+   */
+  uint32_t Register(uint64_t peer_id, int32_t channel, const std::string &variable_name);
+  bool Unregister(uint32_t handle);
+
+  /**
+   * Returns the handle of the variable or -1 if it is not registered. Called for every event, so this returns without
+   * locking as long as no variable is registered and only takes a shared lock otherwise.
+   */
+  int64_t Find(uint64_t peer_id, int32_t channel, const std::string &variable_name, uint32_t &generation);
+
+  /**
+   * Returns true when the handle still belongs to the variable it was returned for by Find().
+   */
+  bool IsCurrent(uint32_t handle, uint32_t generation);
+ private:
+  struct Entry {
+    uint64_t peer_id = 0;
+    int32_t channel = -1;
+    std::string variable_name;
+    bool registered = false;
+    uint32_t generation = 0;
+  };
+
+  std::shared_mutex mutex_;
+  std::atomic<size_t> registered_count_{0};
+  std::unordered_map<uint64_t, std::unordered_map<int32_t, std::unordered_map<std::string, uint32_t>>> handles_;
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> free_handles_;
+};
+
+#endif //HOMEGEAR_NODEJS__VARIABLEHANDLETABLE_H_
@@ -0,0 +1,150 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "Watchdog.h"
+#include <homegear-ipc/HelperFunctions.h>
+
+#include <algorithm>
+#include <vector>
+
+Watchdog::~Watchdog() {
+  Stop();
+}
+
+void Watchdog::Start(int64_t stall_threshold, int64_t interval, std::function<void()> send_heartbeat, std::function<void()> tick) {
+  std::lock_guard<std::mutex> thread_guard(thread_mutex_);
+  if (started_) return;
+  stall_threshold_ = stall_threshold;
+  interval_ = interval;
+  send_heartbeat_.swap(send_heartbeat);
+  tick_.swap(tick);
+  stop_ = false;
+  started_ = true;
+  thread_ = std::thread(&Watchdog::Run, this);
+}
+
+void Watchdog::Stop() {
+  {
+    std::lock_guard<std::mutex> thread_guard(thread_mutex_);
+    stop_ = true;
+  }
+  thread_condition_.notify_all();
+  if (thread_.joinable()) thread_.join();
+  started_ = false;
+}
+
+void Watchdog::Run() {
+  std::unique_lock<std::mutex> thread_lock(thread_mutex_);
+  while (!stop_) {
+    thread_condition_.wait_for(thread_lock, std::chrono::milliseconds(interval_), [&] { return stop_; });
+    if (stop_) break;
+    thread_lock.unlock();
+
+    //Only one heartbeat is queued at a time. A heartbeat stuck in the queue is the stall.
+    if (stall_threshold_ > 0 && heartbeat_sent_time_ == 0) {
+      heartbeat_sent_time_ = Ipc::HelperFunctions::getTime();
+      send_heartbeat_();
+    }
+    if (tick_) tick_();
+
+    thread_lock.lock();
+  }
+}
+
+bool Watchdog::HeartbeatReceived(StallReport &report) {
+  int64_t sent_time = heartbeat_sent_time_.exchange(0);
+  if (sent_time == 0) return false;
+  auto duration = Ipc::HelperFunctions::getTime() - sent_time;
+  if (duration < stall_threshold_) return false;
+
+  stall_count_++;
+  total_stall_time_ += duration;
+  auto max_stall = max_stall_.load();
+  while (duration > max_stall && !max_stall_.compare_exchange_weak(max_stall, duration));
+
+  report.duration = duration;
+  report.slowest_handlers = GetSlowestHandlers(5);
+  return true;
+}
+
+void Watchdog::Record(const std::string &node_id, const std::string &operation, int64_t queue_time, int64_t run_time) {
+  std::lock_guard<std::mutex> handlers_guard(handlers_mutex_);
+  auto &handler = handlers_[node_id + '/' + operation];
+  if (handler.count == 0) {
+    handler.node_id = node_id;
+    handler.operation = operation;
+  }
+  handler.count++;
+  handler.total_queue_time += queue_time;
+  if (queue_time > handler.max_queue_time) handler.max_queue_time = queue_time;
+  handler.total_run_time += run_time;
+  if (run_time > handler.max_run_time) handler.max_run_time = run_time;
+}
+
+Ipc::PVariable Watchdog::GetSlowestHandlers(size_t count) {
+  std::vector<const HandlerStats *> handlers;
+  std::lock_guard<std::mutex> handlers_guard(handlers_mutex_);
+  handlers.reserve(handlers_.size());
+  for (auto &handler : handlers_) {
+    handlers.push_back(&handler.second);
+  }
+  count = std::min(count, handlers.size());
+  std::partial_sort(handlers.begin(), handlers.begin() + count, handlers.end(), [](const HandlerStats *a, const HandlerStats *b) {
+    return a->max_queue_time + a->max_run_time > b->max_queue_time + b->max_run_time;
+  });
+
+  auto result = std::make_shared<Ipc::Variable>(Ipc::VariableType::tArray);
+  result->arrayValue->reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    auto &handler = *handlers.at(i);
+    auto handler_struct = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+    handler_struct->structValue->emplace("nodeId", std::make_shared<Ipc::Variable>(handler.node_id));
+    handler_struct->structValue->emplace("operation", std::make_shared<Ipc::Variable>(handler.operation));
+    handler_struct->structValue->emplace("count", std::make_shared<Ipc::Variable>((int64_t)handler.count));
+    handler_struct->structValue->emplace("averageQueueTime", std::make_shared<Ipc::Variable>((double)handler.total_queue_time / (double)handler.count / 1000.0));
+    handler_struct->structValue->emplace("maxQueueTime", std::make_shared<Ipc::Variable>((double)handler.max_queue_time / 1000.0));
+    handler_struct->structValue->emplace("averageRunTime", std::make_shared<Ipc::Variable>((double)handler.total_run_time / (double)handler.count / 1000.0));
+    handler_struct->structValue->emplace("maxRunTime", std::make_shared<Ipc::Variable>((double)handler.max_run_time / 1000.0));
+    result->arrayValue->push_back(handler_struct);
+  }
+  return result;
+}
+
+Ipc::PVariable Watchdog::GetStats() {
+  auto stats = std::make_shared<Ipc::Variable>(Ipc::VariableType::tStruct);
+  int64_t sent_time = heartbeat_sent_time_;
+  auto current_stall = sent_time != 0 ? Ipc::HelperFunctions::getTime() - sent_time : 0;
+  stats->structValue->emplace("stalled", std::make_shared<Ipc::Variable>(stall_threshold_ > 0 && current_stall >= stall_threshold_));
+  stats->structValue->emplace("stalls", std::make_shared<Ipc::Variable>((int64_t)stall_count_));
+  stats->structValue->emplace("maxStall", std::make_shared<Ipc::Variable>((int64_t)max_stall_));
+  stats->structValue->emplace("totalStallTime", std::make_shared<Ipc::Variable>((int64_t)total_stall_time_));
+  stats->structValue->emplace("slowestHandlers", GetSlowestHandlers(10));
+  return stats;
+}
@@ -0,0 +1,118 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#ifndef HOMEGEAR_NODEJS__WATCHDOG_H_
+#define HOMEGEAR_NODEJS__WATCHDOG_H_
+
+#include <homegear-ipc/Variable.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Detects stalls of the event loop and keeps track of the node handlers taking the longest. A thread sends heartbeats
+ * through the same queue as all other callbacks. When a heartbeat takes longer than the threshold to be processed,
+ * the event loop stalled (or the queue is too long). The thread also calls tick periodically, so pending requests
+ * can be expired independently of the event loop.
+ */
+class Watchdog {
+ public:
+  struct StallReport {
+    int64_t duration = 0;
+    Ipc::PVariable slowest_handlers;
+  };
+
+  ~Watchdog();
+
+  /**
+   * @param stall_threshold Milliseconds a heartbeat may take before it counts as a stall. 0 disables heartbeats.
+   * @param interval Milliseconds between two calls of tick.
+   * @param send_heartbeat Must queue a call of HeartbeatReceived() on the JavaScript thread.
+   * @param tick Called from the watchdog thread.
+   */
+  void Start(int64_t stall_threshold, int64_t interval, std::function<void()> send_heartbeat, std::function<void()> tick);
+  void Stop();
+  bool Enabled() const { return started_; }
+
+  /**
+   * Must be called from the JavaScript thread for every heartbeat.
+   *
+   * @return Returns true when the heartbeat ended a stall. report is filled in that case.
+   */
+  bool HeartbeatReceived(StallReport &report);
+
+  /**
+   * Records the time a handler waited in the queue and took to run, both in microseconds.
+   */
+  void Record(const std::string &node_id, const std::string &operation, int64_t queue_time, int64_t run_time);
+
+  Ipc::PVariable GetStats();
+ private:
+  struct HandlerStats {
+    std::string node_id;
+    std::string operation;
+    uint64_t count = 0;
+    int64_t total_queue_time = 0;
+    int64_t max_queue_time = 0;
+    int64_t total_run_time = 0;
+    int64_t max_run_time = 0;
+  };
+
+  void Run();
+  Ipc::PVariable GetSlowestHandlers(size_t count);
+
+  std::atomic_bool started_{false};
+  int64_t stall_threshold_ = 0;
+  int64_t interval_ = 1000;
+  std::function<void()> send_heartbeat_;
+  std::function<void()> tick_;
+
+  std::mutex thread_mutex_;
+  std::condition_variable thread_condition_;
+  bool stop_ = false;
+  std::thread thread_;
+
+  // {{{ Heartbeat. heartbeat_sent_time_ is 0 while no heartbeat is queued.
+  std::atomic<int64_t> heartbeat_sent_time_{0};
+  std::atomic<uint64_t> stall_count_{0};
+  std::atomic<int64_t> max_stall_{0};
+  std::atomic<int64_t> total_stall_time_{0};
+  // }}}
+
+  std::mutex handlers_mutex_;
+  std::unordered_map<std::string, HandlerStats> handlers_;
+};
+
+#endif //HOMEGEAR_NODEJS__WATCHDOG_H_
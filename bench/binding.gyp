@@ -0,0 +1,9 @@
+{
+  "targets": [
+    {
+      "target_name": "decode",
+      "sources": [ "decode.cpp", "../NapiVariableConverter.cpp" ],
+      "libraries": [ "-lhomegear-ipc" ]
+    }
+  ]
+}
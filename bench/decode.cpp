@@ -0,0 +1,77 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Homegear.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU Lesser General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+*/
+
+#include "../NapiVariableConverter.h"
+
+#include <cassert>
+#include <chrono>
+
+/**
+ * decode(value, iterations): converts value to an Ipc::Variable iterations times and returns the total time in
+ * nanoseconds. Only NapiVariableConverter is involved, so no Homegear and no IPC are needed.
+ */
+napi_value Decode(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[argc];
+  auto status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+  assert(status == napi_ok);
+
+  uint32_t iterations = 1;
+  if (argc == 2) {
+    status = napi_get_value_uint32(env, args[1], &iterations);
+    assert(status == napi_ok);
+  }
+
+  size_t elements = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    auto variable = NapiVariableConverter::getVariable(env, args[0]);
+    elements += variable->arrayValue->size();
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  //Use the result, so the conversion can't be optimized away.
+  if (elements == (size_t)-1) duration = 0;
+
+  napi_value result;
+  status = napi_create_double(env, (double)duration, &result);
+  assert(status == napi_ok);
+  return result;
+}
+
+napi_value Init(napi_env env, napi_value exports) {
+  napi_property_descriptor properties[] = {
+      {"decode", nullptr, Decode, nullptr, nullptr, nullptr, napi_default, nullptr},
+  };
+  auto status = napi_define_properties(env, exports, sizeof(properties) / sizeof(properties[0]), properties);
+  assert(status == napi_ok);
+  return exports;
+}
+
+NAPI_MODULE(decode, Init)
@@ -0,0 +1,53 @@
+'use strict'
+/*
+ * Measures how long it takes to convert JavaScript values to Homegear variables, e.g. the parameters of invoke(). The
+ * values are decoded by a small addon (decode.cpp) that only contains the converter, so neither Homegear nor the IPC
+ * code are involved.
+ *
+ * Build and run it in this directory:
+ *
+ *   node-gyp rebuild && node decode.js [deviceCount] [iterations]
+ *
+ * To compare two versions of the converter, check out each version, rebuild and run the script again.
+ */
+var addon = require('./build/Release/decode.node');
+
+var deviceCount = parseInt(process.argv[2]) || 100;
+var iterations = parseInt(process.argv[3]) || 200;
+
+//A putParamset call with a payload shaped like the result of getAllValues: devices with channels with variables of
+//mixed types.
+function createPayload() {
+    var devices = [];
+    for (var peerId = 1; peerId <= deviceCount; peerId++) {
+        var channels = [];
+        for (var channel = 0; channel < 4; channel++) {
+            var variables = {};
+            for (var i = 0; i < 10; i++) {
+                variables['STATE_' + i] = (i % 2) === 0;
+                variables['LEVEL_' + i] = i * 0.25 + peerId;
+                variables['COUNTER_' + i] = peerId * 1000 + i;
+                variables['NAME_' + i] = 'Device ' + peerId + ' channel ' + channel + ' variable ' + i;
+            }
+            channels.push({INDEX: channel, TYPE: 'SWITCH_VIRTUAL_RECEIVER', PARAMSET: variables});
+        }
+        devices.push({ID: peerId, ADDRESS: 'VDEV' + peerId, TYPEID: 61441, NAME: 'Device ' + peerId, CHANNELS: channels});
+    }
+    return [0, 0, 'MASTER', devices];
+}
+
+var payload = createPayload();
+var payloadSize = JSON.stringify(payload).length;
+
+//Warm up.
+addon.decode(payload, Math.max(1, iterations / 10));
+
+var runs = [];
+for (var run = 0; run < 5; run++) {
+    runs.push(addon.decode(payload, iterations) / iterations);
+}
+runs.sort(function(a, b) { return a - b; });
+var median = runs[2];
+
+console.log('Payload: ' + deviceCount + ' devices, ' + payloadSize + ' bytes as JSON, ' + iterations + ' iterations, 5 runs');
+console.log('Decode (median): ' + (median / 1000).toFixed(1) + ' µs per call, ' + (payloadSize / (median / 1e9) / 1048576).toFixed(1) + ' MiB/s (JSON equivalent)');
@@ -2,7 +2,7 @@
   "targets": [
     {
       "target_name": "homegear",
-      "sources": [ "homegear.cpp", "HomegearObject.cpp", "IpcClient.cpp", "NapiVariableConverter.cpp" ],
+      "sources": [ "homegear.cpp", "HomegearObject.cpp", "IpcClient.cpp", "NapiVariableConverter.cpp", "VariableHandleTable.cpp", "Backpressure.cpp", "ResultCache.cpp", "ValueStore.cpp", "AggregationEngine.cpp", "EventLog.cpp", "Tracer.cpp", "Watchdog.cpp", "Snapshot.cpp" ],
       "libraries": [ "-lhomegear-ipc" ]
     }
   ]